@@ -6,6 +6,8 @@ escape sequence (\x1b[<command>):
     letter, uppercase or not - it is case sensitive)
 */
 //INCLUDES//
+//compiling: cc kilo.c -o kilo -pthread
+//gzip support: add -DKILO_ZLIB -lz, zstd support: add -DKILO_ZSTD -lzstd
 //those 3 are compiling reiquirements for getline()
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE
@@ -13,24 +15,80 @@ escape sequence (\x1b[<command>):
 
 #include <ctype.h>
 #include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdint.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/inotify.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
+#ifdef KILO_ZLIB
+#include <zlib.h>
+#endif
+#ifdef KILO_ZSTD
+#include <zstd.h>
+#endif
 
 //DEFINES//
 #define KILO_VERSION "0.0.1"
 #define KILO_TAB_STOP 4
 #define KILO_QUIT_TIMES 2
+//big files are loaded by several threads, each one with a chunk of at least this many bytes
+#define KILO_CHUNK_MIN (4 << 20)
+//rows are filled by several threads when there are at least this many per thread
+#define KILO_ROWS_MIN (1 << 18)
+#define KILO_MAX_THREADS 64
+/*the line table of files of at least KILO_CACHE_MIN bytes is cached in 
+$KILO_CACHE_DIR (only when it is set), with a bloom filter of the trigrams of 
+each block of KILO_CACHE_BLOCK lines, so searches can skip whole blocks*/
+#define KILO_CACHE_MIN (1 << 20)
+#define KILO_CACHE_BLOCK 1024
+#define KILO_BLOOM_SHIFT 14 //2^14 bits (2KB) per block
+#define KILO_BLOOM_BYTES ((1 << KILO_BLOOM_SHIFT) / 8)
+//files saved as zstd are split in independent frames of this size, so they can be jumped into
+#define KILO_ZSTD_FRAME (1 << 20)
+//rows written by one writev() when saving
+#define KILO_IOV_MAX 1024
+//a search looks at this many rows by itself, the rest is left to a thread
+#define KILO_FIND_SYNC_ROWS 100000
 
 #define CTRL_KEY(k) ((k) & 0x1f)
 
+//OSC 52 copies (see editorOsc52()) of more than this many bytes are not sent
+#define KILO_OSC52_MAX 100000
+//while keys keep coming, the screen is redrawn at most this many times per second
+#define KILO_FPS 60
+/*a diff gives up finding the shortest edit of a region after this many steps, 
+and shows the whole region as replaced (it keeps huge rewrites from taking forever)*/
+#define KILO_DIFF_MAX_D 4096
+//rows per chunk of the row table that snapshots share (see editorSnapshotTake())
+#define KILO_TABLE_CHUNK 4096
+/*the widths of the columns of csv/tsv files come from this many rows at the 
+top and as many spread over the rest of the file (see editorColumnsMeasure())*/
+#define KILO_COL_SAMPLE 100
+#define KILO_COL_MAX_WIDTH 40
+/*the decompressing thread waits while this many bytes are decompressed and 
+not turned into rows yet (that happens about every tenth of a second, when no 
+key comes), so the memory it takes is bounded*/
+#define KILO_PENDING_MAX (64 << 20)
+
+//flags of editorSyntax, they tell which kinds of tokens a filetype highlights
+#define HL_HIGHLIGHT_NUMBERS (1<<0)
+#define HL_HIGHLIGHT_STRINGS (1<<1)
+#define HL_HIGHLIGHT_LOGLEVELS (1<<2)
+
 /* by setting the first constant in the enum to 1000, the rest of the 
 constants get incrementing values of 1001, 1002, 1003, and so on*/
 enum editorKey {
@@ -43,17 +101,276 @@ enum editorKey {
     HOME_KEY,
     END_KEY,
     PAGE_UP,
-    PAGE_DOWN
+    PAGE_DOWN,
+    CTRL_ARROW_LEFT,
+    CTRL_ARROW_RIGHT,
+    CTRL_ARROW_UP,
+    CTRL_ARROW_DOWN,
+    CTRL_HOME_KEY,
+    CTRL_END_KEY
+};
+
+enum editorCompression {
+    COMP_NONE = 0,
+    COMP_GZIP,
+    COMP_ZSTD
+};
+
+//what E.mark selects, from the mark to the cursor
+enum editorMark {
+    MARK_OFF = 0,
+    MARK_CHARS,
+    MARK_LINES
+};
+
+//the possible values of each byte of erow.hl (one per character of render)
+enum editorHighlight {
+    HL_NORMAL = 0,
+    HL_COMMENT,
+    HL_MLCOMMENT,
+    HL_KEYWORD1,
+    HL_KEYWORD2,
+    HL_STRING,
+    HL_NUMBER,
+    HL_LOG_ERROR,
+    HL_LOG_WARN,
+    HL_LOG_INFO,
+    HL_LOG_DEBUG
 };
 
 //DATA//
+struct editorSyntax {
+    char *filetype;
+    //patterns matched against the filename, the ones starting with "." are extensions
+    char **filematch;
+    //keywords ending with "|" are highlighted as HL_KEYWORD2
+    char **keywords;
+    char *singleline_comment_start;
+    char *multiline_comment_start;
+    char *multiline_comment_end;
+    int flags;
+    char delimiter; //the fields of csv/tsv rows are separated by it (see the column mode)
+};
+
 typedef struct erow {
     int size;
     int rsize;
+    /*chars is either owned by the row or borrowed from the storage of the 
+    file (editorBase), which is shared and never modified. Borrowed chars 
+    are not '\0' terminated, so size is the only reliable length*/
     char *chars;
-    char *render;
+    int borrowed;
+    char *render; //NULL until the row is drawn or searched (see editorRenderRow())
+    unsigned char *hl; //highlight of each character of render
+    /*hl_open_comment is the state this row leaves to the next one (inside a 
+    multi-line comment or not), hl_in_comment the one hl was computed with, 
+    or -1 when hl is stale. A row is only highlighted again when the state 
+    the row above leaves changes (see editorHighlightRow())*/
+    int hl_open_comment;
+    int hl_in_comment;
+    long version; //E.snap_version when chars was allocated (see editorRowShared())
+    //where each field starts in chars, only in column mode and once the row is drawn
+    int *fields; //numfields + 1 entries, the last one is size + 1
+    int numfields;
 } erow;
 
+/*an editorBase is the immutable content of a file as it was read from disk, 
+with its line table. Opening a file that is already loaded (same inode, size 
+and mtime) shares it instead of reading it again*/
+struct editorBase {
+    char *path;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    char *data;
+    size_t len;
+    int numlines;
+    size_t *lineoff; //where each line starts in data
+    int *linelen; //length of each line without its "\r\n"
+    int numblocks;
+    unsigned char *blooms; //KILO_BLOOM_BYTES per block, or NULL
+    //when the tables above come from the cache file, they point into this mapping
+    void *cache_map;
+    size_t cache_maplen;
+    int refs; //rows of how many buffers point into data
+    struct editorBase *next;
+};
+
+/*the frames of a seekable zstd file (see editorReadFrameIndex()). coff and doff 
+have numframes + 1 entries: where each frame starts in the compressed and in 
+the decompressed data, and the sizes of both*/
+struct editorFrameIndex {
+    int numframes;
+    off_t *coff;
+    off_t *doff;
+};
+
+/*a compressed file is decompressed by a thread, which leaves the data in 
+pending. The main thread turns it into rows while the user is idle*/
+struct editorDecoder {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond; //signaled when pending is drained, grows or the thread is done
+    int fd;
+    int compression;
+    off_t start; //where decoding starts in the compressed file
+    char *pending; //at most KILO_PENDING_MAX bytes, plus one output of the decompressor
+    size_t pendlen;
+    size_t pendcap;
+    int done; //the thread finished, pending has the last of the data
+    int joined;
+    volatile int cancel;
+    char error[80];
+};
+
+struct snapRow {
+    char *chars;
+    int size;
+};
+
+/*the chars and size of every row of a buffer, kept next to E.row in chunks 
+that snapshots share. A chunk still in a snapshot is copied before it is 
+changed (see editorTableOwn()), so taking a snapshot only copies the chunk 
+pointers*/
+struct tableChunk {
+    int refs; //the buffer and the snapshots that have it
+    int count;
+    struct snapRow rows[]; //table_chunk of them
+};
+
+struct rowTable {
+    struct tableChunk **chunks;
+    int *first; //the row each chunk starts at
+    int numchunks;
+};
+
+/*a snapshot is a frozen version of the rows of a buffer, that other threads 
+can read while the rows keep being edited. Nothing is copied but the chunk 
+pointers of the row table: chars that may be in a snapshot are copied before 
+they are modified (see editorRowOwnChars()) and the old ones are freed once 
+no snapshot can point to them anymore (see editorSnapshotRelease())*/
+struct editorSnapshot {
+    long version;
+    int numrows;
+    struct rowTable table; //read with editorSnapRow()
+    struct editorBase *base; //keeps the borrowed chars alive
+    int pristine_rows;
+};
+
+//chars replaced while a snapshot could still point to them
+struct retiredChars {
+    char *chars;
+    long version; //E.snap_version when it was replaced
+};
+
+//a save running in the background on a snapshot (see editorSaveStart())
+struct editorSaveJob {
+    pthread_t thread;
+    struct editorSnapshot *snap;
+    char *filename;
+    int compression;
+    int dirty; //E.dirty when the snapshot was taken
+    volatile int done;
+    int rc;
+    int error; //errno of the failed write
+    size_t len;
+    int threaded;
+};
+
+//the part of a search that is left to a thread (see editorFindCallBack())
+struct editorSearchJob {
+    pthread_t thread;
+    struct editorSnapshot *snap;
+    char *query;
+    int start;
+    int count; //rows to look at from start, wrapping around the end of the file
+    int direction;
+    int dirty;
+    char delimiter; //in column mode, only column is searched
+    int column;
+    volatile int cancel;
+    volatile int done;
+    int match_row; //-1 when nothing was found
+    int match_col;
+    int threaded;
+};
+
+/*a copy only remembers the range of rows it comes from, and takes its lines 
+out of them (see editorClipMaterialize()) when the first of them is about to 
+change. A cut takes the rows themselves*/
+struct editorClipboard {
+    int linewise; //whole lines, pasted above the cursor row (otherwise spliced at the cursor)
+    int bufid; //the buffer a copy refers to, 0 once the lines are in lines
+    int startrow, startcol;
+    int endrow, endcol; //endcol is not included
+    erow *lines; //only chars, size, borrowed and version are used
+    int numlines;
+    struct editorBase *base; //borrowed lines point into it
+};
+
+/*a change between the file on disk and the buffer: dellen lines from line a 
+of the file were replaced by addlen rows from row b of the buffer*/
+struct diffHunk {
+    int a, dellen;
+    int b, addlen;
+};
+
+//the column mode of csv/tsv files (see editorDrawColumnsRow())
+struct editorColumns {
+    char delimiter;
+    int *widths; //NULL until measured
+    int numcols;
+    int measured; //the rows the widths were measured on, the rows after them were appended since
+    int first; //the first column shown, scrolling is by whole columns
+};
+
+//the diff view (see editorDiffCompute()), hunks are in order
+struct editorDiff {
+    struct editorBase *disk; //the file as it is on disk
+    struct diffHunk *hunks;
+    int numhunks;
+    int dirty; //E.dirty and E.numrows when it was computed
+    int numrows;
+};
+
+/*the state of a buffer that is not being shown, the one being shown lives 
+in E (see editorBufferStash() and editorBufferLoad())*/
+struct editorBuffer {
+    int cx, cy;
+    int rx;
+    int rowoff;
+    int coloff;
+    int numrows;
+    erow *row;
+    int dirty;
+    char *filename;
+    struct editorSyntax *syntax;
+    struct editorBase *base;
+    int follow;
+    int follow_fd;
+    int inotify_fd;
+    int follow_wd;
+    int follow_dirwd;
+    off_t file_offset;
+    char file_lastbyte;
+    ino_t file_ino;
+    int file_partial;
+    int compression;
+    struct editorDecoder *decoder;
+    struct editorFrameIndex *frames;
+    off_t view_start;
+    int pristine_rows;
+    int hl_valid;
+    struct rowTable table;
+    struct editorSaveJob *saving;
+    int id;
+    int mark;
+    int mark_cx, mark_cy;
+    struct editorDiff *diff;
+    struct editorColumns *cols;
+};
+
 struct editorConfig{
     int cx, cy;
     int rx;
@@ -66,12 +383,182 @@ struct editorConfig{
     erow *row; // editor row (can be called just as erow instead of struct erow thanks to typedef)
     int dirty;
     char *filename;
+    struct editorSyntax *syntax; //NULL when the filetype is unknown
+    struct editorBase *base; //the file storage borrowed by the rows, or NULL
+    int follow; //tail -f mode: data appended to the file becomes new rows
+    int follow_fd; //kept open, so a rotated (moved away) file can still be drained
+    int inotify_fd;
+    int follow_wd; //inotify watch of the file
+    int follow_dirwd; //inotify watch of its directory, to see the file being recreated
+    off_t file_offset; //bytes of the file already turned into rows
+    char file_lastbyte; //the byte at file_offset - 1, to notice a rewritten file
+    ino_t file_ino;
+    int file_partial; //the file does not end with a newline, so new data continues the last row
+    int compression; //how the file is compressed on disk, it is saved the same way
+    struct editorDecoder *decoder; //NULL when nothing is being decompressed
+    struct editorFrameIndex *frames; //NULL unless the file is a seekable zstd
+    off_t view_start; //a jump into a compressed file shows it from here (then it can't be saved)
+    int pristine_rows; //the rows before this one are still the lines of base
+    int hl_valid; //the rows before this one leave the right comment state to the next one
+    struct rowTable table; //what snapshots take of the rows (see editorSnapshotTake())
+    struct editorSaveJob *saving; //NULL unless a save is running
+    int id; //tells buffers apart after they move in buffers
+    int mark; //MARK_OFF, or what is selected from (mark_cx, mark_cy) to the cursor
+    int mark_cx, mark_cy;
+    struct editorDiff *diff; //NULL unless the diff view is shown
+    struct editorColumns *cols; //NULL unless in column mode
+    //buffers[curbuf] is stale, the state of the current buffer is the fields above
+    struct editorBuffer *buffers;
+    int numbuffers;
+    int curbuf;
+    int lastid;
+    struct editorClipboard clip; //shared by all the buffers
+    int headless; //batch mode: no terminal at all
+    //snapshots are per thread (the rows are too), shared by all the buffers
+    long snap_version; //bumped by every snapshot taken
+    long *snap_live; //versions of the snapshots not released yet
+    int snap_numlive;
+    struct retiredChars *retired;
+    int numretired;
+    struct editorSearchJob *search; //background part of the current search, or NULL
+    //the snapshot searched, kept while the query is typed if the rows don't change
+    struct editorSnapshot *search_snap;
+    int search_snap_dirty;
     char statusmsg[80];
     time_t statusmsg_time; 
     struct termios orig_termios;
 };
 
-struct editorConfig E;
+/*each thread has its own E, so the workers of the batch mode (see editorBatch()) 
+can use the same row functions on different files at the same time*/
+__thread struct editorConfig E;
+
+//what the row operations allocated and copied, checked by the self test (kilo -t)
+struct rowStats {
+    long allocs; //malloc() and realloc() calls
+    long copied; //bytes moved by memcpy() and memmove(), not the ones realloc() may move
+};
+__thread struct rowStats rowstats;
+
+//the row operations and the row table allocate and copy through these, so rowstats counts them
+static inline void *rowAlloc(void *p, size_t size) {
+    rowstats.allocs++;
+    return realloc(p, size);
+}
+
+static inline void rowCopy(void *dst, const void *src, size_t n) {
+    rowstats.copied += n;
+    memcpy(dst, src, n);
+}
+
+static inline void rowMove(void *dst, const void *src, size_t n) {
+    rowstats.copied += n;
+    memmove(dst, src, n);
+}
+
+//every file loaded, shared by all the buffers (and by all the threads)
+struct editorBase *bases = NULL;
+pthread_mutex_t bases_lock = PTHREAD_MUTEX_INITIALIZER;
+
+//FILETYPES//
+char *C_HL_extensions[] = { ".c", ".h", ".cpp", ".hpp", ".cc", NULL };
+char *C_HL_keywords[] = {
+    "switch", "if", "while", "for", "break", "continue", "return", "else",
+    "struct", "union", "typedef", "static", "enum", "class", "case", "default",
+    "#include", "#define", "#if", "#ifdef", "#ifndef", "#endif",
+    "int|", "long|", "double|", "float|", "char|", "unsigned|", "signed|",
+    "void|", "const|", "size_t|", NULL
+};
+
+char *PY_HL_extensions[] = { ".py", NULL };
+char *PY_HL_keywords[] = {
+    "def", "class", "if", "elif", "else", "for", "while", "return", "import",
+    "from", "as", "with", "try", "except", "finally", "raise", "lambda", "pass",
+    "break", "continue", "in", "not", "and", "or", "is", "yield",
+    "None|", "True|", "False|", "self|", NULL
+};
+
+char *CONF_HL_extensions[] = {
+    ".conf", ".cfg", ".ini", ".yaml", ".yml", ".toml", ".sh", NULL
+};
+
+char *LOG_HL_extensions[] = { ".log", ".out", ".err", NULL };
+
+char *CSV_HL_extensions[] = { ".csv", NULL };
+
+char *TSV_HL_extensions[] = { ".tsv", ".tab", NULL };
+
+//HLDB stands for "highlight database"
+struct editorSyntax HLDB[] = {
+    {
+        "c",
+        C_HL_extensions,
+        C_HL_keywords,
+        "//", "/*", "*/",
+        HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS,
+        0
+    },
+    {
+        "python",
+        PY_HL_extensions,
+        PY_HL_keywords,
+        "#", NULL, NULL,
+        HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS,
+        0
+    },
+    {
+        "conf",
+        CONF_HL_extensions,
+        NULL,
+        "#", NULL, NULL,
+        HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS,
+        0
+    },
+    {
+        "log",
+        LOG_HL_extensions,
+        NULL,
+        NULL, NULL, NULL,
+        HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS | HL_HIGHLIGHT_LOGLEVELS,
+        0
+    },
+    {
+        "csv",
+        CSV_HL_extensions,
+        NULL,
+        NULL, NULL, NULL,
+        HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS,
+        ','
+    },
+    {
+        "tsv",
+        TSV_HL_extensions,
+        NULL,
+        NULL, NULL, NULL,
+        HL_HIGHLIGHT_NUMBERS,
+        '\t'
+    },
+};
+
+#define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
+
+//log level words and the highlight each one gets
+struct {
+    char *word;
+    int hl;
+} LOGLEVELS[] = {
+    { "FATAL", HL_LOG_ERROR },
+    { "CRITICAL", HL_LOG_ERROR },
+    { "ERROR", HL_LOG_ERROR },
+    { "ERR", HL_LOG_ERROR },
+    { "WARNING", HL_LOG_WARN },
+    { "WARN", HL_LOG_WARN },
+    { "NOTICE", HL_LOG_INFO },
+    { "INFO", HL_LOG_INFO },
+    { "DEBUG", HL_LOG_DEBUG },
+    { "TRACE", HL_LOG_DEBUG },
+    { NULL, 0 }
+};
 
 
 /*The needs to know the arguments and return the value of 
@@ -79,14 +566,33 @@ that function. Prototype functions elp to sort things out*/
 //PROTOTYPES//
 void editorSetStatusMessage(const char *fmt, ...);
 void editorRefreshScreen();
+int editorIdle();
 char *editorPrompt(char *prompt, void (*callback)(char *, int));
+void editorRenderRow(erow *row);
+int editorCompressionOfName(char *filename);
+int editorCompress(int compression, char *buf, size_t len, char **out, size_t *outlen);
+int editorOpenCompressed(char *filename, int compression);
+void editorBaseRelease(struct editorBase *base);
+void editorClipMaterialize();
+void editorOutputWrite(const char *s, int len);
+void editorOutputFlush();
+void editorDiffClose();
+void editorDiffCompute(struct editorDiff *d);
+struct editorBase *editorBaseAcquire(char *filename);
+void editorColumnsOn(char delimiter);
+void editorColumnsOff();
+void editorColumnsAuto();
 
 //TERMINAL// -> low-level terminal inputs
 
 // die function is a error handler (prints error message and exits)
 void die(const char *s){
-    write(STDOUT_FILENO, "\x1b[2J", 4);
-    write(STDOUT_FILENO, "\x1b[H", 3);
+    if (!E.headless) {
+        //the frames still being written would come after the clearing
+        editorOutputFlush();
+        write(STDOUT_FILENO, "\x1b[2J", 4);
+        write(STDOUT_FILENO, "\x1b[H", 3);
+    }
     //perror looks to the global errno variable and prints a error message
     //suposed to give context about the error
     perror(s);
@@ -126,8 +632,28 @@ void enableRawMode() {
         die("tcgetattr");
 }
 
+//a key read too early (see editorKeyRepeats()) and given back, or -1
+static int pushed_key = -1;
+
+void editorUnreadKey(int c) {
+    pushed_key = c;
+}
+
+//1 if a keypress is waiting to be read
+int editorKeyPending() {
+    if (pushed_key != -1)
+        return 1;
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+    return poll(&pfd, 1, 0) == 1;
+}
+
 //waits for a keypress and returns it
 int editorReadKey() {
+    if (pushed_key != -1) {
+        int key = pushed_key;
+        pushed_key = -1;
+        return key;
+    }
     int nread;
     char c;
     while ((nread = read(STDIN_FILENO, &c, 1)) != 1){
@@ -136,11 +662,14 @@ int editorReadKey() {
         //checking if the data is available later
         if (nread == -1 && errno != EAGAIN)
             die("read");
+        //read() timed out without a keypress, so there is time for background work
+        if (editorIdle())
+            editorRefreshScreen();
     }
 
     if (c == '\x1b') {
 
-        char seq[3];
+        char seq[5];
         if (read(STDIN_FILENO, &seq[0], 1) != 1)
             return '\x1b';
         if (read(STDIN_FILENO, &seq[1], 1) != 1)
@@ -149,6 +678,22 @@ int editorReadKey() {
             if (seq[1] >= '0' && seq[1] <= '9') {
                 if (read(STDIN_FILENO, &seq[2], 1) != 1)
                     return '\x1b';
+                //\x1b[1;<modifier><letter>, the modifier 5 is Ctrl (the others are ignored)
+                if (seq[2] == ';') {
+                    if (read(STDIN_FILENO, &seq[3], 1) != 1)
+                        return '\x1b';
+                    if (read(STDIN_FILENO, &seq[4], 1) != 1)
+                        return '\x1b';
+                    int ctrl = (seq[3] == '5');
+                    switch (seq[4]) {
+                        case 'A': return ctrl ? CTRL_ARROW_UP : ARROW_UP;
+                        case 'B': return ctrl ? CTRL_ARROW_DOWN : ARROW_DOWN;
+                        case 'C': return ctrl ? CTRL_ARROW_RIGHT : ARROW_RIGHT;
+                        case 'D': return ctrl ? CTRL_ARROW_LEFT : ARROW_LEFT;
+                        case 'H': return ctrl ? CTRL_HOME_KEY : HOME_KEY;
+                        case 'F': return ctrl ? CTRL_END_KEY : END_KEY;
+                    }
+                }
                 if (seq[2] == '~') {
                     switch (seq[1]) {
                         case '1': return HOME_KEY;
@@ -231,6 +776,548 @@ int getWindowSize(int *rows, int *cols) {
     }
 }
 
+//SYNTAX HIGHLIGHTING//
+int is_separator(int c) {
+    //strchr() looks for the first occurrence of c in the string and returns NULL if there is none
+    return isspace((unsigned char)c) || c == '\0' || strchr(",.()+-/*=~%<>[]{}:;\"'", c) != NULL;
+}
+
+/*fills row->hl starting in the state in_comment (inside a multi-line comment 
+or not) and returns the state left to the next row*/
+int editorUpdateSyntax(erow *row, int in_comment) {
+    row->hl = realloc(row->hl, row->rsize ? row->rsize : 1);
+    memset(row->hl, HL_NORMAL, row->rsize);
+
+    if (E.syntax == NULL)
+        return 0;
+
+    char **keywords = E.syntax->keywords;
+
+    char *scs = E.syntax->singleline_comment_start;
+    char *mcs = E.syntax->multiline_comment_start;
+    char *mce = E.syntax->multiline_comment_end;
+
+    int scs_len = scs ? strlen(scs) : 0;
+    int mcs_len = mcs ? strlen(mcs) : 0;
+    int mce_len = mce ? strlen(mce) : 0;
+
+    //the beginning of the line counts as a separator
+    int prev_sep = 1;
+    int in_string = 0; //holds the quote that opened the string
+    in_comment = in_comment && mcs_len && mce_len;
+
+    int i = 0;
+    while (i < row->rsize) {
+        char c = row->render[i];
+        unsigned char prev_hl = (i > 0) ? row->hl[i - 1] : HL_NORMAL;
+
+        //single-line comments paint the rest of the row
+        if (scs_len && !in_string && !in_comment) {
+            if (!strncmp(&row->render[i], scs, scs_len)) {
+                memset(&row->hl[i], HL_COMMENT, row->rsize - i);
+                break;
+            }
+        }
+
+        if (mcs_len && mce_len && !in_string) {
+            if (in_comment) {
+                row->hl[i] = HL_MLCOMMENT;
+                if (!strncmp(&row->render[i], mce, mce_len)) {
+                    memset(&row->hl[i], HL_MLCOMMENT, mce_len);
+                    i += mce_len;
+                    in_comment = 0;
+                    prev_sep = 1;
+                    continue;
+                } else {
+                    i++;
+                    continue;
+                }
+            } else if (!strncmp(&row->render[i], mcs, mcs_len)) {
+                memset(&row->hl[i], HL_MLCOMMENT, mcs_len);
+                i += mcs_len;
+                in_comment = 1;
+                continue;
+            }
+        }
+
+        if (E.syntax->flags & HL_HIGHLIGHT_STRINGS) {
+            if (in_string) {
+                row->hl[i] = HL_STRING;
+                //a backslash escapes the next character, even the closing quote
+                if (c == '\\' && i + 1 < row->rsize) {
+                    row->hl[i + 1] = HL_STRING;
+                    i += 2;
+                    continue;
+                }
+                if (c == in_string)
+                    in_string = 0;
+                i++;
+                prev_sep = 1;
+                continue;
+            } else if (c == '"' || c == '\'') {
+                in_string = c;
+                row->hl[i] = HL_STRING;
+                i++;
+                continue;
+            }
+        }
+
+        if (E.syntax->flags & HL_HIGHLIGHT_NUMBERS) {
+            if ((isdigit((unsigned char)c) && (prev_sep || prev_hl == HL_NUMBER)) ||
+                (c == '.' && prev_hl == HL_NUMBER)) {
+                row->hl[i] = HL_NUMBER;
+                i++;
+                prev_sep = 0;
+                continue;
+            }
+        }
+
+        //keywords and log levels are whole words, so they need a separator on both sides
+        if (prev_sep) {
+            int j;
+            int found = 0;
+            for (j = 0; keywords && keywords[j]; j++) {
+                int klen = strlen(keywords[j]);
+                int kw2 = keywords[j][klen - 1] == '|';
+                if (kw2)
+                    klen--;
+
+                if (klen <= row->rsize - i &&
+                    !strncmp(&row->render[i], keywords[j], klen) &&
+                    is_separator(i + klen < row->rsize ? row->render[i + klen] : '\0')) {
+                    memset(&row->hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
+                    i += klen;
+                    found = 1;
+                    break;
+                }
+            }
+            if (!found && (E.syntax->flags & HL_HIGHLIGHT_LOGLEVELS)) {
+                for (j = 0; LOGLEVELS[j].word; j++) {
+                    int llen = strlen(LOGLEVELS[j].word);
+                    if (llen <= row->rsize - i &&
+                        !strncmp(&row->render[i], LOGLEVELS[j].word, llen) &&
+                        is_separator(i + llen < row->rsize ? row->render[i + llen] : '\0')) {
+                        memset(&row->hl[i], LOGLEVELS[j].hl, llen);
+                        i += llen;
+                        found = 1;
+                        break;
+                    }
+                }
+            }
+            if (found) {
+                prev_sep = 0;
+                continue;
+            }
+        }
+
+        prev_sep = is_separator(c);
+        i++;
+    }
+
+    return in_comment;
+}
+
+//highlights a row starting with in_comment, unless hl was computed with it already
+void editorHighlightFrom(int at, int in_comment) {
+    erow *row = &E.row[at];
+    if (row->hl && row->hl_in_comment == in_comment)
+        return;
+    editorRenderRow(row);
+    row->hl_open_comment = editorUpdateSyntax(row, in_comment);
+    row->hl_in_comment = in_comment;
+}
+
+/*makes sure E.row[at].hl is up to date. Rows are only highlighted when they 
+are about to be drawn. The state the rows before E.hl_valid leave is right, 
+so the row after them is highlighted for good and moves the mark down. 
+Reaching a row up to a screen below the mark walks the rows in between, 
+further than that the row starts from whatever the row above it has (outside 
+of a comment if nothing), so a jump never highlights the whole file*/
+void editorHighlightRow(int at) {
+    if (at < 0 || at >= E.numrows)
+        return;
+    //multi-line comments are the only state carried from one row to the next,
+    //without them each row can be highlighted on its own
+    if (E.syntax == NULL || E.syntax->multiline_comment_start == NULL) {
+        editorHighlightFrom(at, 0);
+        return;
+    }
+    if (at - E.hl_valid > E.screenrows) {
+        int in_comment = 0;
+        if (at > 0 && E.row[at - 1].hl && E.row[at - 1].hl_in_comment != -1)
+            in_comment = E.row[at - 1].hl_open_comment;
+        editorHighlightFrom(at, in_comment);
+        return;
+    }
+    while (E.hl_valid <= at) {
+        int j = E.hl_valid;
+        editorHighlightFrom(j, j > 0 ? E.row[j - 1].hl_open_comment : 0);
+        E.hl_valid++;
+    }
+    editorHighlightFrom(at, at > 0 ? E.row[at - 1].hl_open_comment : 0);
+}
+
+//returns the ANSI color code of a highlight (30 to 37 and 90 to 97 are foreground colors)
+int editorSyntaxToColor(int hl) {
+    switch (hl) {
+        case HL_COMMENT:
+        case HL_MLCOMMENT: return 36;
+        case HL_KEYWORD1: return 33;
+        case HL_KEYWORD2: return 32;
+        case HL_STRING: return 35;
+        case HL_NUMBER: return 31;
+        case HL_LOG_ERROR: return 91;
+        case HL_LOG_WARN: return 93;
+        case HL_LOG_INFO: return 92;
+        case HL_LOG_DEBUG: return 90;
+        default: return 39; //39 is the default foreground color
+    }
+}
+
+//chooses E.syntax by matching E.filename against the filematch patterns of HLDB
+void editorSelectSyntaxHighlight() {
+    E.syntax = NULL;
+    if (E.filename != NULL) {
+        //strrchr() returns a pointer to the last occurrence of "." (the extension)
+        char *ext = strrchr(E.filename, '.');
+        int extlen = ext ? (int)strlen(ext) : 0;
+        //"app.log.gz" is highlighted like "app.log"
+        if (ext && editorCompressionOfName(E.filename) != COMP_NONE) {
+            char *end = ext;
+            ext = NULL;
+            char *p;
+            for (p = end - 1; p >= E.filename && *p != '/'; p--) {
+                if (*p == '.') {
+                    ext = p;
+                    break;
+                }
+            }
+            extlen = ext ? end - ext : 0;
+        }
+        unsigned int j;
+        for (j = 0; j < HLDB_ENTRIES && E.syntax == NULL; j++) {
+            struct editorSyntax *s = &HLDB[j];
+            int i;
+            for (i = 0; s->filematch[i]; i++) {
+                int is_ext = (s->filematch[i][0] == '.');
+                if ((is_ext && ext && (int)strlen(s->filematch[i]) == extlen &&
+                     !strncmp(ext, s->filematch[i], extlen)) ||
+                    (!is_ext && strstr(E.filename, s->filematch[i]))) {
+                    E.syntax = s;
+                    break;
+                }
+            }
+        }
+    }
+
+    //every row was highlighted with the old filetype
+    int filerow;
+    for (filerow = 0; filerow < E.numrows; filerow++) {
+        E.row[filerow].hl_in_comment = -1;
+        E.row[filerow].hl_open_comment = 0;
+    }
+    E.hl_valid = 0;
+}
+
+//SNAPSHOTS//
+//1 if a snapshot not released yet can point to the chars of row
+int editorRowShared(erow *row) {
+    int j;
+    for (j = 0; j < E.snap_numlive; j++) {
+        if (E.snap_live[j] >= row->version)
+            return 1;
+    }
+    return 0;
+}
+
+//frees the chars of a row, or keeps them until the snapshots that can point to them are gone
+void editorRetireChars(erow *row) {
+    if (row->borrowed)
+        return;
+    if (!editorRowShared(row)) {
+        free(row->chars);
+        return;
+    }
+    E.retired = realloc(E.retired, sizeof(struct retiredChars) * (E.numretired + 1));
+    E.retired[E.numretired].chars = row->chars;
+    E.retired[E.numretired].version = E.snap_version;
+    E.numretired++;
+}
+
+//rows per chunk of the row tables, the self test makes it small to split them often
+static int table_chunk = KILO_TABLE_CHUNK;
+
+struct tableChunk *editorChunkNew() {
+    struct tableChunk *chunk = rowAlloc(NULL, sizeof(struct tableChunk) + sizeof(struct snapRow) * table_chunk);
+    chunk->refs = 1;
+    chunk->count = 0;
+    return chunk;
+}
+
+//drops a reference to a chunk, the last one frees it
+void editorChunkRelease(struct tableChunk *chunk) {
+    if (--chunk->refs == 0)
+        free(chunk);
+}
+
+//the chunk row j is in, row numrows is in the last one
+int editorTableFind(struct rowTable *t, int j) {
+    int lo = 0, hi = t->numchunks - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (t->first[mid] <= j)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+//row j of a snapshot, *hint is the chunk of the previous call (start with 0)
+struct snapRow *editorSnapRow(struct editorSnapshot *snap, int j, int *hint) {
+    struct rowTable *t = &snap->table;
+    int c = *hint;
+    if (c >= t->numchunks || j < t->first[c] || j >= t->first[c] + t->chunks[c]->count)
+        c = *hint = editorTableFind(t, j);
+    return &t->chunks[c]->rows[j - t->first[c]];
+}
+
+//chunk c of E.table, copied first if a snapshot has it too
+struct tableChunk *editorTableOwn(int c) {
+    struct tableChunk *chunk = E.table.chunks[c];
+    if (chunk->refs > 1) {
+        struct tableChunk *copy = editorChunkNew();
+        copy->count = chunk->count;
+        rowCopy(copy->rows, chunk->rows, sizeof(struct snapRow) * chunk->count);
+        editorChunkRelease(chunk);
+        E.table.chunks[c] = chunk = copy;
+    }
+    return chunk;
+}
+
+//where the chunks from c start, after the counts of the ones before changed
+void editorTableRenumber(int c) {
+    struct rowTable *t = &E.table;
+    for (; c < t->numchunks; c++)
+        t->first[c] = (c == 0) ? 0 : t->first[c - 1] + t->chunks[c - 1]->count;
+}
+
+//replaces n chunks from c with the num chunks of chunks
+void editorTableSplice(int c, int n, struct tableChunk **chunks, int num) {
+    struct rowTable *t = &E.table;
+    int j;
+    for (j = c; j < c + n; j++)
+        editorChunkRelease(t->chunks[j]);
+    if (num > n) {
+        t->chunks = rowAlloc(t->chunks, sizeof(struct tableChunk *) * (t->numchunks + num - n));
+        t->first = rowAlloc(t->first, sizeof(int) * (t->numchunks + num - n));
+    }
+    rowMove(&t->chunks[c + num], &t->chunks[c + n], sizeof(struct tableChunk *) * (t->numchunks - c - n));
+    if (num > 0)
+        rowCopy(&t->chunks[c], chunks, sizeof(struct tableChunk *) * num);
+    t->numchunks += num - n;
+    editorTableRenumber(c);
+}
+
+//takes the chars and size of row j again, after it changed
+void editorTableSet(int j) {
+    int c = editorTableFind(&E.table, j);
+    struct tableChunk *chunk = editorTableOwn(c);
+    struct snapRow *row = &chunk->rows[j - E.table.first[c]];
+    row->chars = E.row[j].chars;
+    row->size = E.row[j].size;
+}
+
+/*adds the n rows of E.row from at to the table. They go in the chunk at is 
+in when they fit, otherwise that chunk and the rows are spread evenly over 
+as many chunks as they need (rows added after the end fill new chunks)*/
+void editorTableInsert(int at, int n) {
+    struct rowTable *t = &E.table;
+    int c = 0, off = 0, count = 0;
+    struct tableChunk *old = NULL;
+    if (t->numchunks > 0) {
+        c = editorTableFind(t, at);
+        old = t->chunks[c];
+        off = at - t->first[c];
+        count = old->count;
+    }
+    int j;
+    if (old && count + n <= table_chunk) {
+        struct tableChunk *chunk = editorTableOwn(c);
+        rowMove(&chunk->rows[off + n], &chunk->rows[off], sizeof(struct snapRow) * (count - off));
+        for (j = 0; j < n; j++) {
+            chunk->rows[off + j].chars = E.row[at + j].chars;
+            chunk->rows[off + j].size = E.row[at + j].size;
+        }
+        chunk->count += n;
+        editorTableRenumber(c + 1);
+        return;
+    }
+
+    //appending keeps the chunk as it is, otherwise it is split with the rows
+    int keep = (old && off == count);
+    int total = keep ? n : count + n;
+    int num = (total + table_chunk - 1) / table_chunk;
+    struct tableChunk **chunks = rowAlloc(NULL, sizeof(struct tableChunk *) * num);
+    int k = 0;
+    for (j = 0; j < num; j++) {
+        struct tableChunk *chunk = editorChunkNew();
+        int fill = keep ? (total - k < table_chunk ? total - k : table_chunk) : total / num + (j < total % num);
+        for (; chunk->count < fill; k++) {
+            struct snapRow *row = &chunk->rows[chunk->count++];
+            if (!keep && k < off) {
+                rowCopy(row, &old->rows[k], sizeof(*row));
+            } else if (!keep && k >= off + n) {
+                rowCopy(row, &old->rows[k - n], sizeof(*row));
+            } else {
+                int r = at + k - (keep ? 0 : off);
+                row->chars = E.row[r].chars;
+                row->size = E.row[r].size;
+            }
+        }
+        chunks[j] = chunk;
+    }
+    if (keep)
+        editorTableSplice(c + 1, 0, chunks, num);
+    else
+        editorTableSplice(c, old ? 1 : 0, chunks, num);
+    free(chunks);
+}
+
+//merges chunk c with the next one if one of them is small and they fit in one
+void editorTableMerge(int c) {
+    struct rowTable *t = &E.table;
+    if (c < 0 || c >= t->numchunks - 1)
+        return;
+    struct tableChunk *next = t->chunks[c + 1];
+    int count = t->chunks[c]->count;
+    if ((count >= table_chunk / 4 && next->count >= table_chunk / 4) || count + next->count > table_chunk)
+        return;
+    struct tableChunk *chunk = editorTableOwn(c);
+    rowCopy(&chunk->rows[count], next->rows, sizeof(struct snapRow) * next->count);
+    chunk->count += next->count;
+    editorTableSplice(c + 1, 1, NULL, 0);
+}
+
+/*removes n rows from at, the chunks left small around them are merged. Only 
+the first and the last chunk can keep rows, the ones in between are dropped 
+all at once (without copying them for the snapshots that have them)*/
+void editorTableDelete(int at, int n) {
+    struct rowTable *t = &E.table;
+    int first = editorTableFind(t, at);
+    int c = first;
+    int off = at - t->first[c];
+    int dropfrom = -1, dropped = 0;
+    while (n > 0) {
+        int count = t->chunks[c]->count;
+        int m = count - off < n ? count - off : n;
+        if (m == count) {
+            if (dropfrom == -1)
+                dropfrom = c;
+            dropped++;
+        } else {
+            struct tableChunk *chunk = editorTableOwn(c);
+            rowMove(&chunk->rows[off], &chunk->rows[off + m], sizeof(struct snapRow) * (count - off - m));
+            chunk->count -= m;
+        }
+        n -= m;
+        c++;
+        off = 0; //the next chunk is deleted from its start
+    }
+    //the chunks before first did not change
+    if (dropped)
+        editorTableSplice(dropfrom, dropped, NULL, 0);
+    else
+        editorTableRenumber(first + 1);
+    if (t->numchunks == 0)
+        return;
+    c = editorTableFind(t, at);
+    editorTableMerge(c);
+    editorTableMerge(c - 1);
+}
+
+void editorTableFree(struct rowTable *t) {
+    int j;
+    for (j = 0; j < t->numchunks; j++)
+        editorChunkRelease(t->chunks[j]);
+    free(t->chunks);
+    free(t->first);
+    memset(t, 0, sizeof(*t));
+}
+
+/*full chunks for numrows rows, left to be filled by the caller (see 
+editorFillRows()), for a buffer that has no rows yet*/
+void editorTableReserve(int numrows) {
+    struct rowTable *t = &E.table;
+    int num = (numrows + table_chunk - 1) / table_chunk;
+    t->chunks = rowAlloc(NULL, sizeof(struct tableChunk *) * (num ? num : 1));
+    t->first = rowAlloc(NULL, sizeof(int) * (num ? num : 1));
+    t->numchunks = num;
+    int j;
+    for (j = 0; j < num; j++) {
+        t->chunks[j] = editorChunkNew();
+        t->chunks[j]->count = (j == num - 1) ? numrows - j * table_chunk : table_chunk;
+        t->first[j] = j * table_chunk;
+    }
+}
+
+/*freezes the rows of the current buffer. It costs a copy of the chunk 
+pointers of the row table, the chunks and the chars are shared with the live 
+rows until they are modified*/
+struct editorSnapshot *editorSnapshotTake() {
+    struct editorSnapshot *snap = malloc(sizeof(struct editorSnapshot));
+    //rows allocated from now on get a bigger version, so they are never in this snapshot
+    snap->version = E.snap_version++;
+    snap->numrows = E.numrows;
+    struct rowTable *t = &snap->table;
+    t->numchunks = E.table.numchunks;
+    t->chunks = rowAlloc(NULL, sizeof(struct tableChunk *) * (t->numchunks + 1));
+    t->first = rowAlloc(NULL, sizeof(int) * (t->numchunks + 1));
+    rowCopy(t->chunks, E.table.chunks, sizeof(struct tableChunk *) * t->numchunks);
+    rowCopy(t->first, E.table.first, sizeof(int) * t->numchunks);
+    int j;
+    for (j = 0; j < t->numchunks; j++)
+        t->chunks[j]->refs++;
+    snap->base = E.base;
+    snap->pristine_rows = E.pristine_rows;
+    if (snap->base) {
+        pthread_mutex_lock(&bases_lock);
+        snap->base->refs++;
+        pthread_mutex_unlock(&bases_lock);
+    }
+    E.snap_live = realloc(E.snap_live, sizeof(long) * (E.snap_numlive + 1));
+    E.snap_live[E.snap_numlive++] = snap->version;
+    return snap;
+}
+
+//only called by the thread that took the snapshot, after the readers of it are done
+void editorSnapshotRelease(struct editorSnapshot *snap) {
+    int j;
+    for (j = 0; j < E.snap_numlive; j++) {
+        if (E.snap_live[j] == snap->version) {
+            E.snap_live[j] = E.snap_live[--E.snap_numlive];
+            break;
+        }
+    }
+    //chars replaced before the oldest snapshot left was taken can't be in any of them
+    long oldest = E.snap_version;
+    for (j = 0; j < E.snap_numlive; j++) {
+        if (E.snap_live[j] < oldest)
+            oldest = E.snap_live[j];
+    }
+    int kept = 0;
+    for (j = 0; j < E.numretired; j++) {
+        if (E.retired[j].version <= oldest)
+            free(E.retired[j].chars);
+        else
+            E.retired[kept++] = E.retired[j];
+    }
+    E.numretired = kept;
+    editorBaseRelease(snap->base);
+    editorTableFree(&snap->table);
+    free(snap);
+}
+
 //ROW OPERATIONS//
 int editorRowCxToRx(erow *row, int cx) {
     int rx = 0;
@@ -259,8 +1346,24 @@ int editorRowRxToCx(erow *row, int rx) {
     return cx;
 }
 
-//fills the render string with the content of an erow
+/*called after chars changes. The render is only built again when it is 
+needed, so rows that are never drawn or searched never get one*/
 void editorUpdateRow(erow *row) {
+    free(row->render);
+    row->render = NULL;
+    row->rsize = 0;
+    free(row->fields);
+    row->fields = NULL;
+    //hl follows render, it will be recomputed when the row is drawn
+    row->hl_in_comment = -1;
+    //the chars or the size changed
+    editorTableSet(row - E.row);
+}
+
+//fills the render string with the content of an erow, if it is not there yet
+void editorRenderRow(erow *row) {
+  if (row->render != NULL)
+    return;
   int tabs = 0;
   int j;
   for (j = 0; j < row->size; j++)
@@ -268,7 +1371,6 @@ void editorUpdateRow(erow *row) {
     if (row->chars[j] == '\t') 
         tabs++;
 
-  free(row->render);
   /*allocates the memory of the size necessary: 
   1 byte for each character, 4 for each tab (because each tab is
   4 spaces in this code according to KILO_TAB_STOP 4)*/
@@ -292,23 +1394,57 @@ void editorUpdateRow(erow *row) {
   row->rsize = idx;
 }
 
+/*every function that modifies rows calls this with the first row it changes 
+(rows after it may move, so they are considered changed too)*/
+void editorRowsChanged(int at) {
+    if (at < E.pristine_rows)
+        E.pristine_rows = at;
+    //the comment state the rows from at leave can change now
+    if (at < E.hl_valid)
+        E.hl_valid = at;
+    //a copy that refers to these rows takes its lines before they change
+    if (E.clip.bufid && E.clip.bufid == E.id && at <= E.clip.endrow)
+        editorClipMaterialize();
+}
+
+/*copies the chars into memory of the row itself before they get modified: 
+borrowed chars belong to the file and shared ones can be in a snapshot*/
+void editorRowOwnChars(erow *row) {
+    if (!row->borrowed && !editorRowShared(row))
+        return;
+    char *chars = rowAlloc(NULL, row->size + 1);
+    rowCopy(chars, row->chars, row->size);
+    chars[row->size] = '\0';
+    editorRetireChars(row);
+    row->chars = chars;
+    row->borrowed = 0;
+    row->version = E.snap_version;
+}
+
 void editorInsertRow(int at, char *s, size_t len) {
     //at validation
     if (at < 0 || at > E.numrows)
         return;
+    editorRowsChanged(at);
 
     //allocates bytes for each row times the size of the  row
-    E.row = realloc(E.row, sizeof(erow) * (E.numrows + 1));
+    E.row = rowAlloc(E.row, sizeof(erow) * (E.numrows + 1));
     //makes room at the specified index for the new row
-    memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at));
+    rowMove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at));
 
     E.row[at].size = len;
-    E.row[at].chars = malloc(len + 1);
-    memcpy(E.row[at].chars, s, len);
+    E.row[at].chars = rowAlloc(NULL, len + 1);
+    rowCopy(E.row[at].chars, s, len);
     E.row[at].chars[len] = '\0';
+    E.row[at].borrowed = 0;
+    E.row[at].version = E.snap_version;
 
     E.row[at].rsize = 0;
     E.row[at].render = NULL;
+    E.row[at].hl = NULL;
+    E.row[at].fields = NULL;
+    E.row[at].hl_open_comment = 0;
+    editorTableInsert(at, 1);
     editorUpdateRow(&E.row[at]);
     E.numrows++;
     E.dirty++;
@@ -316,24 +1452,93 @@ void editorInsertRow(int at, char *s, size_t len) {
 
 void editorFreeRow(erow *row) { //frees the memory of the deleted erow
     free(row->render);
-    free(row->chars);
+    editorRetireChars(row);
+    free(row->hl);
+    free(row->fields);
 }
 
 void editorDelRow(int at) {
     if (at < 0 || at >= E.numrows)
         return;
+    editorRowsChanged(at);
     editorFreeRow(&E.row[at]);
+    editorTableDelete(at, 1);
     //copies the content of E.row[at +1] in E.row[at], which was freed at the command above
-    memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
+    rowMove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
     E.numrows--; //one row less now
     E.dirty++;
 }
 
+/*inserts n rows at once, with a single move of the rows after them. The chars 
+are copied, except borrowed ones from the storage of this buffer*/
+void editorInsertRows(int at, erow *src, int n, struct editorBase *base) {
+    if (at < 0 || at > E.numrows || n <= 0)
+        return;
+    editorRowsChanged(at);
+    E.row = rowAlloc(E.row, sizeof(erow) * (E.numrows + n));
+    rowMove(&E.row[at + n], &E.row[at], sizeof(erow) * (E.numrows - at));
+
+    int j;
+    for (j = 0; j < n; j++) {
+        erow *row = &E.row[at + j];
+        row->size = src[j].size;
+        if (src[j].borrowed && base != NULL && base == E.base) {
+            row->chars = src[j].chars;
+            row->borrowed = 1;
+        } else {
+            row->chars = rowAlloc(NULL, src[j].size + 1);
+            rowCopy(row->chars, src[j].chars, src[j].size);
+            row->chars[src[j].size] = '\0';
+            row->borrowed = 0;
+        }
+        row->version = E.snap_version;
+        row->rsize = 0;
+        row->render = NULL;
+        row->hl = NULL;
+        row->fields = NULL;
+        row->hl_open_comment = 0;
+        row->hl_in_comment = -1;
+    }
+    editorTableInsert(at, n);
+    E.numrows += n;
+    E.dirty++;
+}
+
+/*deletes n rows at once. With out, their chars are moved there instead of 
+being freed (the caller owns them then)*/
+void editorDelRows(int at, int n, erow *out) {
+    if (at < 0 || n <= 0 || at + n > E.numrows)
+        return;
+    editorRowsChanged(at);
+    int j;
+    for (j = 0; j < n; j++) {
+        erow *row = &E.row[at + j];
+        if (out) {
+            free(row->render);
+            free(row->hl);
+            free(row->fields);
+            out[j] = *row;
+            out[j].render = NULL;
+            out[j].rsize = 0;
+            out[j].hl = NULL;
+            out[j].fields = NULL;
+        } else {
+            editorFreeRow(row);
+        }
+    }
+    editorTableDelete(at, n);
+    rowMove(&E.row[at], &E.row[at + n], sizeof(erow) * (E.numrows - at - n));
+    E.numrows -= n;
+    E.dirty++;
+}
+
 void editorRowInsertChar(erow *row, int at, int c) {
     if (at < 0 || at > row->size)
         at = row->size;
+    editorRowsChanged(row - E.row);
+    editorRowOwnChars(row);
     //reallocation with the size of the chars +2 because you have to fit the char and the null byte
-    row->chars = realloc(row->chars, row->size +2);
+    row->chars = rowAlloc(row->chars, row->size +2);
     /*copies memory block into a new location, but not like memcpy
     "In general, memcpy is implemented in a simple (but fast) manner. 
     Simplistically, it just loops over the data (in order), copying 
@@ -341,7 +1546,7 @@ void editorRowInsertChar(erow *row, int at, int c) {
     being overwritten while it's being read. Memmove does more work 
     to ensure it handles the overlap correctly."*/
     /*memmove(pointer to destination, pointer to source, number of bytes to copy)*/
-    memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
+    rowMove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
     row->size++;
     row->chars[at] = c;
     editorUpdateRow(row);
@@ -352,8 +1557,10 @@ void editorRowInsertChar(erow *row, int at, int c) {
 void editorRowDelChar(erow *row, int at) {
     if (at < 0 || at >= row->size)
         return;
+    editorRowsChanged(row - E.row);
+    editorRowOwnChars(row);
     //overwrite the deleted character with the characters that come after it 
-    memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
+    rowMove(&row->chars[at], &row->chars[at + 1], row->size - at);
     row->size--;
     editorUpdateRow(row);
     E.dirty++;
@@ -380,6 +1587,8 @@ void editorinsertNewline() {
         erow *row = &E.row[E.cy];
         editorInsertRow(E.cy + 1, &row->chars[E.cx], row->size - E.cx);
         row = &E.row[E.cy];
+        editorRowsChanged(E.cy);
+        editorRowOwnChars(row);
         row->size = E.cx;
         row->chars[row->size] = '\0';
         editorUpdateRow(row);
@@ -389,14 +1598,30 @@ void editorinsertNewline() {
 }
 
 void editorRowAppendString(erow *row, char *s, size_t len) {
-    row->chars = realloc(row->chars, row->size + len + 1); //expand the row size
-    memcpy(&row->chars[row->size], s,len); //copy the content to the end of the row
+    editorRowsChanged(row - E.row);
+    editorRowOwnChars(row);
+    row->chars = rowAlloc(row->chars, row->size + len + 1); //expand the row size
+    rowCopy(&row->chars[row->size], s,len); //copy the content to the end of the row
     row->size += len; //update row size
     row->chars[row->size] = '\0';
     editorUpdateRow(row);
     E.dirty++;
 }
 
+//replaces the whole content of a row with a copy of s
+void editorRowSetString(erow *row, char *s, size_t len) {
+    editorRowsChanged(row - E.row);
+    editorRetireChars(row);
+    row->chars = rowAlloc(NULL, len + 1);
+    rowCopy(row->chars, s, len);
+    row->chars[len] = '\0';
+    row->size = len;
+    row->borrowed = 0;
+    row->version = E.snap_version;
+    editorUpdateRow(row);
+    E.dirty++;
+}
+
 //applies editorRowDelChar to delete the character that is to the left of the cursor.
 void editorDelChar() {
     if (E.cy == E.numrows)
@@ -416,8 +1641,8 @@ void editorDelChar() {
     }
 }char *editorPrompt(char *prompt, void (*callback)(char *, int));
 
-char *editorRowsToString(int *buflen) {
-    int totlen = 0;
+char *editorRowsToString(size_t *buflen) {
+    size_t totlen = 0;
     int j;
     for (j = 0; j < E.numrows; j++)
         totlen += E.row[j].size + 1;
@@ -435,526 +1660,4655 @@ char *editorRowsToString(int *buflen) {
     return buf;
 }
 
-//editorOpen() takes a filename and opens the file for reading using fopen()
-void editorOpen(char *filename) {
-    free(E.filename);
-    // strdup() makes a copy of the given string (filename)
-    //it alocates the required memory assuming you will free() it 
-    E.filename = strdup(filename);
-    FILE *fp = fopen(filename, "r");
-    //! is changing fp from nonzero statement to zero and vice-versa
-    if (!fp) 
-        die("fopen");
-    
-    char *line = NULL;
-    size_t linecap = 0;
-    ssize_t linelen;
-    //linelen = getline(&line, &linecap, fp);
-    //if (linelen != -1) {
-    while ((linelen = getline(&line, &linecap, fp)) != -1) {
-        while (linelen > 0 && (line[linelen -1] == '\n' || line[linelen -1] == '\r'))
-            linelen--;
-        editorInsertRow(E.numrows, line, linelen); //it increments E.dirty, but it is not supposed to happen when it has just opened
-        ////set size to o the length of the message
-        //E.row.size = linelen; 
-        //E.row.chars = malloc(linelen + 1);
-        ////copies the num of characters of linelen from line to E.row.chars
-        //memcpy(E.row.chars, line, linelen);
-        //E.row.chars[linelen] = '\0';
-        //E.numrows = 1;
+//FILE STORAGE//
+//the most threads a file is loaded with, one per core when 0 (the self test sets it)
+static int max_threads = 0;
+
+//how many threads to use for work items, when each thread should get at least min of them
+int editorThreadsFor(size_t work, size_t min) {
+    long n = max_threads ? max_threads : sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > KILO_MAX_THREADS)
+        n = KILO_MAX_THREADS;
+    if ((size_t)n > work / min)
+        n = work / min;
+    return n < 1 ? 1 : n;
+}
+
+/*runs fn once for each of the nthreads structs of argsize bytes in args, each 
+one in its own thread (the first one in the calling thread) and waits for all*/
+void editorRunParallel(void *(*fn)(void *), void *args, size_t argsize, int nthreads) {
+    pthread_t threads[KILO_MAX_THREADS];
+    int started[KILO_MAX_THREADS];
+    int j;
+    for (j = 1; j < nthreads; j++)
+        started[j] = pthread_create(&threads[j], NULL, fn, (char *)args + j * argsize) == 0;
+    fn(args);
+    for (j = 1; j < nthreads; j++) {
+        if (started[j])
+            pthread_join(threads[j], NULL);
+        else
+            fn((char *)args + j * argsize); //no thread, so it runs here
     }
-    free(line);
-    fclose(fp);
-    E.dirty = 0; //corrects the incrementation when the while loop calls editorInsertRow()
 }
 
-void editorSave() {
-    /*Note: If you’re using Bash on Windows, you will have to press Escape 3 
-    times to get one Escape keypress to register in our program, because the 
-    read() calls in editorReadKey() that look for an escape sequence never time out*/
-    if (E.filename == NULL) { //this means it is a new file
-        E.filename = editorPrompt("Save as: %s (Esc to cancel)", NULL);
-        //the file will not be null anymore if 
-        if (E.filename == NULL) {
-            editorSetStatusMessage("save aborted");
-            return;
+//a byte range of a file being loaded
+struct loadChunk {
+    struct editorBase *base;
+    int fd;
+    size_t start, end;
+    int short_read; //the file ended before end (it shrank while being read)
+    int scan; //0 when the line table is already known (from the cache)
+    size_t *nl; //positions of the newlines inside the chunk
+    int numnl;
+    int firstline; //index of the line that ends at nl[0]
+    size_t linestart; //where that line starts, it can be in an earlier chunk
+};
+
+//reads a chunk and finds its newlines
+void *editorLoadChunk(void *arg) {
+    struct loadChunk *c = arg;
+    char *data = c->base->data;
+    size_t pos = c->start;
+    while (pos < c->end) {
+        //pread() reads at an offset, so the threads can share fd
+        ssize_t n = pread(c->fd, &data[pos], c->end - pos, pos);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            c->end = pos;
+            c->short_read = 1;
+            break;
         }
+        pos += n;
     }
-    int len;
-    char *buf = editorRowsToString(&len);
 
-    // O_CREAT creates a new file if it doesn't already existis
-    // O_RDWR opens for read and writing 
-    /*" 0644 is the standard permissions you usually want for text files.
-    It gives the owner of the file permission to read and write the file, 
-    and everyone else only gets permission to read the file"*/
-    int fd = open(strcat(E.filename, ".txt"), O_RDWR | O_CREAT, 0644);
-    /*"The normal way to overwrite a file is to pass the O_TRUNC 
-    flag to open(), which truncates the file completely, making 
-    it an empty file, before writing the new data into it. By 
-    truncating the file ourselves to the same length as the data 
-    we are planning to write into it, we are making the whole overwriting 
-    operation a little bit safer in case the ftruncate() call succeeds but the write() call fails. "*/
-    if (fd != -1) {
-        if (ftruncate(fd, len) != -1) { //truncates the size of the file
-            close(fd);
-            free(buf);
-            E.dirty = 0; //now the modified code was saved, so it is not "dirty" anymore
-            editorSetStatusMessage("%d bytes written to disk", len);
-            return;
+    if (!c->scan)
+        return NULL;
+    //memchr() is vectorized by the C library, it checks many bytes per instruction
+    int cap = 0;
+    char *p = &data[c->start];
+    char *end = &data[c->end];
+    while (p < end && (p = memchr(p, '\n', end - p)) != NULL) {
+        if (c->numnl == cap) {
+            cap = cap ? cap * 2 : 1024;
+            c->nl = realloc(c->nl, sizeof(size_t) * cap);
         }
-        close(fd);
+        c->nl[c->numnl++] = p - data;
+        p++;
     }
-    free(buf);
-    editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
+    return NULL;
 }
 
-//FIND//
-void editorFindCallBack(char *query, int key) {
-    static int last_match = -1;
-    static int direction = 1;
-    //returns immediately Enter or Esc when one of them is presed
-    if (key == '\r'|| key == '\x1b') {
-        last_match = -1;
-        direction = 1;
-        return;
-    } else if (key == ARROW_RIGHT || key == ARROW_DOWN) {
-        direction = 1;
-    } else if (key == ARROW_LEFT || key == ARROW_UP) {
-        direction = -1;
-    } else {
-        last_match = -1;
-        direction = 1;
+//fills the part of the line table of the lines that end inside a chunk
+void *editorIndexChunk(void *arg) {
+    struct loadChunk *c = arg;
+    struct editorBase *base = c->base;
+    size_t start = c->linestart;
+    int i;
+    for (i = 0; i < c->numnl; i++) {
+        size_t linelen = c->nl[i] - start;
+        //the "\r" of "\r\n" is trimmed like the "\n"
+        while (linelen > 0 && base->data[start + linelen - 1] == '\r')
+            linelen--;
+        base->lineoff[c->firstline + i] = start;
+        base->linelen[c->firstline + i] = linelen;
+        start = c->nl[i] + 1;
     }
+    return NULL;
+}
 
-    if (last_match == -1)
-        direction = 1;
-    
-    //current is the index of the current searched row 
-    int current = last_match;
-    int i;
+/*reads the file and builds its line table (unless scan is 0). Big files are 
+split in chunks that are read and scanned in parallel, then the tables of the 
+chunks are stitched in order and filled in parallel too. Returns -1 if the 
+file was shorter than expected*/
+int editorBaseLoad(struct editorBase *base, int fd, int scan) {
+    size_t size = base->size;
+    base->data = malloc(size ? size : 1);
 
-    //loop through all the rows of the file    
-    for (i = 0; i < E.numrows; i++) {
-        current += direction;
-        if (current == -1)
-            current = E.numrows -1;
-        else if (current == E.numrows)
-            current = 0;
+    int nthreads = editorThreadsFor(size, KILO_CHUNK_MIN);
+    struct loadChunk chunks[KILO_MAX_THREADS];
+    int j;
+    for (j = 0; j < nthreads; j++) {
+        struct loadChunk *c = &chunks[j];
+        memset(c, 0, sizeof(*c));
+        c->base = base;
+        c->fd = fd;
+        c->start = size / nthreads * j;
+        c->end = (j == nthreads - 1) ? size : size / nthreads * (j + 1);
+        c->scan = scan;
+    }
+    editorRunParallel(editorLoadChunk, chunks, sizeof(struct loadChunk), nthreads);
 
-        // *row points to the currently analyzed row
-        erow *row = &E.row[current];
-        /*finds the first occurrence of the substring (query) in the string (row->render).
-        The terminating '\0' characters are not compared. This function RETURNS A POINTER 
-        TO THE FIRST OCCURENCE in row->render of any of the entire sequence of characters 
-        specified in query, or a null pointer if the sequence is not present in haystack.*/
-        char *match = strstr(row->render, query);
-        if (match) {
-            last_match = current;
-            // i checks the row, so the current row analysed is always i
-            E.cy = current;
-            //subtracts row->render in order to know where in row->render the match happens
-            E.cx = editorRowRxToCx(row, match - row->render);
-            E.rowoff = E.numrows;
+    if (!scan) {
+        int short_read = 0;
+        for (j = 0; j < nthreads; j++)
+            short_read |= chunks[j].short_read;
+        base->len = size;
+        return short_read ? -1 : 0;
+    }
+
+    //stitching: the lines of each chunk come after the lines of the chunks before it
+    int numlines = 0;
+    size_t linestart = 0;
+    int numchunks = nthreads;
+    base->len = size;
+    for (j = 0; j < numchunks; j++) {
+        chunks[j].firstline = numlines;
+        chunks[j].linestart = linestart;
+        numlines += chunks[j].numnl;
+        if (chunks[j].numnl)
+            linestart = chunks[j].nl[chunks[j].numnl - 1] + 1;
+        //the data after a short read is missing, so the file ends there
+        if (chunks[j].short_read) {
+            base->len = chunks[j].end;
+            numchunks = j + 1;
             break;
         }
     }
-}
 
-void editorFind() {
-    int saved_cx = E.cx;
-    int saved_cy = E.cy;
-    int saved_coloff = E.coloff;
-    int saved_rowoff = E.rowoff;
-    //query is a substring of the current row
-    char *query = editorPrompt("Search %s (Use Esc/Arrows/Enter)", editorFindCallBack);
-    // query == NULL means Esc was
-    if (query == NULL) {
-        free(query);
-        } else {
-            E.cx = saved_cx;
-            E.cy = saved_cy;
-            E.coloff = saved_coloff;
-            E.rowoff = saved_rowoff; 
-        } 
+    //the last line has no newline
+    int partial = linestart < base->len;
+    base->numlines = numlines + partial;
+    base->lineoff = malloc(sizeof(size_t) * (base->numlines ? base->numlines : 1));
+    base->linelen = malloc(sizeof(int) * (base->numlines ? base->numlines : 1));
+    editorRunParallel(editorIndexChunk, chunks, sizeof(struct loadChunk), numchunks);
+    if (partial) {
+        size_t linelen = base->len - linestart;
+        while (linelen > 0 && base->data[linestart + linelen - 1] == '\r')
+            linelen--;
+        base->lineoff[numlines] = linestart;
+        base->linelen[numlines] = linelen;
+    }
+
+    for (j = 0; j < nthreads; j++)
+        free(chunks[j].nl);
+    return base->len < size ? -1 : 0;
 }
 
-//APPEND BUFFER//
-//pointer to the buffer memory and a length
-struct abuf {
-    char *b;
-    int len;
+//CACHE//
+//the cache file is this header, the line table, then the bloom filters
+struct cacheHeader {
+    char magic[8];
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t numlines;
+    uint32_t blocklines;
+    uint32_t bloombytes;
+    uint64_t numblocks;
 };
-//ABUF_INIT is a constant that represents an empty buffer
-//acts as an constructor to abuf type
-#define ABUF_INIT {NULL, 0}
 
-void abAppend(struct abuf *ab, const char *s, int len) {
-    
-    //realloc gives a block of memory resized
-    //new size = current size + size of the appended string
-    char *new = realloc(ab->b, ab->len + len);
-    
-    //to prevent to append nothing to the buffer
-    if (new == NULL)
-        return;
-    //copies the memory of the string s after the end of the current
-    //data in the buffer and updates the abuf's lenght
-    memcpy(&new[ab->len], s, len);
-    ab->b = new;
-    ab->len += len;
+#define KILO_CACHE_MAGIC "KILOIDX1"
+
+//the cache file of filename, named after a hash of its full path, or NULL if caching is off
+char *editorCachePath(char *filename) {
+    char *dir = getenv("KILO_CACHE_DIR");
+    if (dir == NULL || *dir == '\0')
+        return NULL;
+    char *full = realpath(filename, NULL);
+    char *p = full ? full : filename;
+    //FNV-1a hash
+    uint64_t h = 14695981039346656037ULL;
+    for (; *p; p++) {
+        h ^= (unsigned char)*p;
+        h *= 1099511628211ULL;
+    }
+    free(full);
+    char *path = malloc(strlen(dir) + 32);
+    sprintf(path, "%s/%016llx.kidx", dir, (unsigned long long)h);
+    return path;
 }
 
-void abFree(struct abuf *ab) {
-    free(ab->b);
+//where the trigram starting at p goes in a bloom filter
+static inline unsigned int editorTrigramHash(unsigned char *p) {
+    uint32_t t = (p[0] << 16) | (p[1] << 8) | p[2];
+    return (t * 2654435761u) >> (32 - KILO_BLOOM_SHIFT);
 }
 
-//OUTPUT//
-void editorScroll() {
-    E.rx = 0;
-    //sets E.rx to its proper value
-    if (E.cy < E.numrows) {
-        E.rx = editorRowCxToRx(&E.row[E.cy], E.cx);
+//a range of blocks whose bloom filters are being built
+struct bloomRange {
+    struct editorBase *base;
+    int from, to;
+};
+
+void *editorBuildBlooms(void *arg) {
+    struct bloomRange *r = arg;
+    struct editorBase *base = r->base;
+    int b;
+    for (b = r->from; b < r->to; b++) {
+        unsigned char *bloom = &base->blooms[(size_t)b * KILO_BLOOM_BYTES];
+        int last = (b + 1) * KILO_CACHE_BLOCK;
+        if (last > base->numlines)
+            last = base->numlines;
+        int j;
+        for (j = b * KILO_CACHE_BLOCK; j < last; j++) {
+            unsigned char *line = (unsigned char *)&base->data[base->lineoff[j]];
+            int i;
+            for (i = 0; i + 2 < base->linelen[j]; i++) {
+                unsigned int h = editorTrigramHash(&line[i]);
+                bloom[h >> 3] |= 1 << (h & 7);
+            }
+        }
     }
-    // E.rowoff is used to check if the cursor moved outside the visible window
-    //if it is outside, is adjusts
-    if (E.cy < E.rowoff) { //checks if the cursor is above the window
-        E.rowoff = E.cy;
+    return NULL;
+}
+
+/*builds the bloom filters of base and writes its cache file. It is written 
+to a temporary file first, so a cache file is always complete*/
+void editorCacheSave(struct editorBase *base) {
+    char *path = editorCachePath(base->path);
+    if (path == NULL || base->size < KILO_CACHE_MIN) {
+        free(path);
+        return;
     }
-    if (E.cy >= E.rowoff + E.screenrows) { //checks if the cursor is under the window
-        E.rowoff = E.cy - E.screenrows + 1;
+
+    base->numblocks = (base->numlines + KILO_CACHE_BLOCK - 1) / KILO_CACHE_BLOCK;
+    base->blooms = calloc((size_t)base->numblocks + 1, KILO_BLOOM_BYTES);
+    int nthreads = editorThreadsFor(base->numblocks, 16);
+    struct bloomRange ranges[KILO_MAX_THREADS];
+    int j;
+    for (j = 0; j < nthreads; j++) {
+        ranges[j].base = base;
+        ranges[j].from = base->numblocks / nthreads * j;
+        ranges[j].to = (j == nthreads - 1) ? base->numblocks : base->numblocks / nthreads * (j + 1);
     }
-    if (E.rx < E.coloff) { //checks if the cursor is left to the window
-        E.coloff = E.rx;
+    editorRunParallel(editorBuildBlooms, ranges, sizeof(struct bloomRange), nthreads);
+
+    struct cacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, KILO_CACHE_MAGIC, sizeof(h.magic));
+    h.dev = base->dev;
+    h.ino = base->ino;
+    h.size = base->size;
+    h.mtime_sec = base->mtime.tv_sec;
+    h.mtime_nsec = base->mtime.tv_nsec;
+    h.numlines = base->numlines;
+    h.blocklines = KILO_CACHE_BLOCK;
+    h.bloombytes = KILO_BLOOM_BYTES;
+    h.numblocks = base->numblocks;
+
+    //batch threads can save the cache of the same file at once, so each gets its own temporary
+    char *tmp = malloc(strlen(path) + 16);
+    sprintf(tmp, "%s.XXXXXX", path);
+    int fd = mkstemp(tmp);
+    FILE *fp = fd == -1 ? NULL : fdopen(fd, "w");
+    if (fd != -1 && fp == NULL) {
+        close(fd);
+        unlink(tmp);
     }
-    if (E.rx >= E.coloff + E.screencols) { //checks if the cursor is right to the window
-        E.coloff = E.rx - E.screencols + 1;
+    if (fp) {
+        int ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+            fwrite(base->lineoff, sizeof(size_t), base->numlines, fp) == (size_t)base->numlines &&
+            fwrite(base->linelen, sizeof(int), base->numlines, fp) == (size_t)base->numlines &&
+            fwrite(base->blooms, KILO_BLOOM_BYTES, base->numblocks, fp) == (size_t)base->numblocks;
+        //fclose() flushes, so it can fail too
+        if (fclose(fp) != 0 || !ok || rename(tmp, path) == -1)
+            unlink(tmp);
     }
+    free(tmp);
+    free(path);
 }
 
-//draws the selected symbol ("~" for now) in all columns read and stored in the E.screencols
-void editorDrawRows(struct abuf *ab) {
-    int y;
-    for (y = 0; y < E.screenrows; y++) {
-        //filerow gets the number row of the file and uses it as index of E.row
-        int filerow = y + E.rowoff;
-        //if the current drawing row is part of the text buffer
-        if (filerow >= E.numrows) {
-            if (E.numrows == 0 && y == E.screenrows / 3) {
-                //welcome is a buffer to interpolate KILO_VERSION into the welcomimng page
-                char welcome[80];
-                int welcomelen = snprintf(welcome, sizeof(welcome),
-                    "yeah %s", KILO_VERSION);
-                //if the size of the buffer is too big, it adjusts to the screen size
-                if (welcomelen > E.screencols) 
-                    welcomelen = E.screencols;
-                //finds the middle of the screen
-                int padding = (E.screencols - welcomelen) / 2;
-                // if (padding) is the same as if (padding != 0)
-                if (padding) {
-                    abAppend(ab, "~", 1);
-                    padding--;
-                } 
-                // while (padding-1 != 0)
-                while (padding--) 
-                    abAppend(ab, " ", 1);
-                abAppend(ab, welcome, welcomelen);
-            } else {
-                abAppend(ab, "~", 1);
+/*maps the cache file of base, if there is one matching the file exactly, and 
+points the line table and the blooms of base into it. Returns 0 if it did*/
+int editorCacheLoad(struct editorBase *base) {
+    char *path = editorCachePath(base->path);
+    if (path == NULL || base->size < KILO_CACHE_MIN) {
+        free(path);
+        return -1;
+    }
+    int fd = open(path, O_RDONLY);
+    free(path);
+    if (fd == -1)
+        return -1;
+
+    struct stat st;
+    struct cacheHeader h;
+    if (fstat(fd, &st) == -1 || pread(fd, &h, sizeof(h), 0) != sizeof(h) ||
+        memcmp(h.magic, KILO_CACHE_MAGIC, sizeof(h.magic)) != 0 ||
+        h.dev != (uint64_t)base->dev || h.ino != (uint64_t)base->ino ||
+        h.size != (uint64_t)base->size || h.mtime_sec != base->mtime.tv_sec ||
+        h.mtime_nsec != base->mtime.tv_nsec || h.blocklines != KILO_CACHE_BLOCK ||
+        h.bloombytes != KILO_BLOOM_BYTES ||
+        //bounded first, so the size below can't overflow
+        h.numlines > (uint64_t)base->size + 1 || h.numlines > INT_MAX ||
+        h.numblocks != (h.numlines + KILO_CACHE_BLOCK - 1) / KILO_CACHE_BLOCK ||
+        (uint64_t)st.st_size != sizeof(h) + h.numlines * (sizeof(size_t) + sizeof(int)) +
+            h.numblocks * KILO_BLOOM_BYTES) {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+    /*a cache file that is corrupt (or written by a buggy kilo) must not make 
+    rows point out of the data: the lines have to be in order, each one after 
+    the newline of the line before it, and inside the file*/
+    size_t *lineoff = (size_t *)((char *)map + sizeof(h));
+    int *linelen = (int *)&lineoff[h.numlines];
+    size_t next = 0;
+    uint64_t j;
+    for (j = 0; j < h.numlines; j++) {
+        if (lineoff[j] < next || linelen[j] < 0 || lineoff[j] > (size_t)base->size ||
+            (size_t)linelen[j] > (size_t)base->size - lineoff[j]) {
+            munmap(map, st.st_size);
+            return -1;
+        }
+        next = lineoff[j] + linelen[j] + 1;
+    }
+    base->cache_map = map;
+    base->cache_maplen = st.st_size;
+    base->numlines = h.numlines;
+    base->lineoff = lineoff;
+    base->linelen = linelen;
+    base->numblocks = h.numblocks;
+    base->blooms = (unsigned char *)&linelen[h.numlines];
+    return 0;
+}
+
+void editorCacheDrop(struct editorBase *base) {
+    if (base->cache_map)
+        munmap(base->cache_map, base->cache_maplen);
+    base->cache_map = NULL;
+    base->lineoff = NULL;
+    base->linelen = NULL;
+    base->blooms = NULL;
+    base->numlines = 0;
+    base->numblocks = 0;
+}
+
+//the trigrams of a query, to test it against the bloom filters of the blocks
+struct findFilter {
+    int numtrigrams; //0 means no block can be skipped
+    unsigned int *trigrams;
+    struct editorBase *base; //where the blooms are
+    int pristine_rows; //the rows still as they are in base
+    int lastblock; //the last block tested and whether it can match
+    int lastresult;
+};
+
+void editorFindFilterInit(struct findFilter *f, char *query, struct editorBase *base, int pristine_rows) {
+    f->numtrigrams = 0;
+    f->trigrams = NULL;
+    f->base = base;
+    f->pristine_rows = pristine_rows;
+    f->lastblock = -1;
+    f->lastresult = 1;
+    int len = strlen(query);
+    //every search matches chars, which the blooms are built from, so any query of 3 or more bytes can use them
+    if (base == NULL || base->blooms == NULL || len < 3)
+        return;
+    f->trigrams = malloc(sizeof(unsigned int) * (len - 2));
+    int i;
+    for (i = 0; i + 2 < len; i++)
+        f->trigrams[f->numtrigrams++] = editorTrigramHash((unsigned char *)&query[i]);
+}
+
+void editorFindFilterFree(struct findFilter *f) {
+    free(f->trigrams);
+}
+
+/*if the block of row at can't have the query, returns how many rows there 
+are until the end of the block in the given direction, or 0*/
+int editorFindSkip(struct findFilter *f, int at, int direction) {
+    if (f->numtrigrams == 0)
+        return 0;
+    int block = at / KILO_CACHE_BLOCK;
+    //only blocks whose rows are all still the lines of the file on disk
+    if ((block + 1) * KILO_CACHE_BLOCK > f->pristine_rows || block >= f->base->numblocks)
+        return 0;
+    if (block != f->lastblock) {
+        unsigned char *bloom = &f->base->blooms[(size_t)block * KILO_BLOOM_BYTES];
+        int i;
+        f->lastblock = block;
+        f->lastresult = 1;
+        for (i = 0; i < f->numtrigrams; i++) {
+            if (!(bloom[f->trigrams[i] >> 3] & (1 << (f->trigrams[i] & 7)))) {
+                f->lastresult = 0;
+                break;
             }
-        } else {
-            //if the current drawing row comes after the text buffer
-            int len = E.row[filerow].rsize - E.coloff;
-            if (len < 0) // happens when it is above the screen
-                len = 0; //returns to the leftmost column
-            if (len > E.screencols)
-                len = E.screencols;
-            abAppend(ab, &E.row[filerow].render[E.coloff], len);
         }
-        //cleans each line afte it is redrawn
-        // K erases in line (K2 erases the whole line)
-        abAppend(ab, "\x1b[K", 3);
-        //prints a newline after the last row it draws, 
-        //since the status bar is the final line being drawn on the screen
-        abAppend(ab, "\r\n", 2);
     }
+    if (f->lastresult)
+        return 0;
+    if (direction == 1)
+        return (block + 1) * KILO_CACHE_BLOCK - at;
+    return at - block * KILO_CACHE_BLOCK + 1;
 }
 
-void editorDrawStatusBar(struct abuf *ab) {
-    //7m inverts the colors
-    abAppend(ab, "\x1b[7m", 4);
-    char status[80], rstatus[80];
-    //if E.filename != 0, then E.filename = E.filename, else, E.filename = "[No Name]"
-    //if E.dirty != 0, then "(modified)", else, ""
-    int len = snprintf(status, sizeof(status), "%.20s - %d lines %s", E.filename ? E.filename : "[No Name]", E.numrows, E.dirty ? "(modified)" : "");
-    //sums 1 to E.cy is zero indexed 
-    int rlen = snprintf(rstatus, sizeof(rstatus), "%d/%d", E.cy + 1, E.numrows);
-    if(len > E.screencols)
-        len = E.screencols; 
-    abAppend(ab, status, len);
-    while (len < E.screencols) {
-        if (E.screencols - len == rlen) {
-            abAppend(ab, rstatus, rlen);
-            break;
-        } else {
-            abAppend(ab, " ", 1);
-            len++;   
+//returns the storage of filename, shared if it is already loaded, or NULL with errno set
+struct editorBase *editorBaseAcquire(char *filename) {
+    struct stat st;
+    if (stat(filename, &st) == -1)
+        return NULL;
+
+    struct editorBase *base;
+    pthread_mutex_lock(&bases_lock);
+    for (base = bases; base; base = base->next) {
+        if (base->dev == st.st_dev && base->ino == st.st_ino && base->size == st.st_size &&
+            base->mtime.tv_sec == st.st_mtim.tv_sec && base->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+            base->refs++;
+            pthread_mutex_unlock(&bases_lock);
+            return base;
         }
     }
-    //the m command in causes the text printed after it to be 
-    //printed with various possible attributes including: 
-    //bold (1), underscore (4), blink (5), and inverted colors (7) 
-    abAppend(ab, "\x1b[m", 3);
-    abAppend(ab, "\r\n", 2);
+    //the file is read without holding the lock, so other threads are not blocked by it
+    pthread_mutex_unlock(&bases_lock);
+
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+        return NULL;
+    //the size of the opened file, it could have changed since stat()
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return NULL;
+    }
+
+    base = calloc(1, sizeof(struct editorBase));
+    base->path = strdup(filename);
+    base->dev = st.st_dev;
+    base->ino = st.st_ino;
+    base->size = st.st_size;
+    base->mtime = st.st_mtim;
+    /*with a cache file, the file only has to be read, not scanned. The data is 
+    read and not mapped: rows borrow it, and a save in place truncates and 
+    rewrites the very file (or another process can cut it shorter) under them*/
+    if (editorCacheLoad(base) == 0) {
+        if (editorBaseLoad(base, fd, 0) == -1) {
+            //the file changed under the cache
+            editorCacheDrop(base);
+            free(base->data);
+            editorBaseLoad(base, fd, 1);
+        }
+    } else {
+        editorBaseLoad(base, fd, 1);
+        editorCacheSave(base);
+    }
+    close(fd);
+
+    base->refs = 1;
+    pthread_mutex_lock(&bases_lock);
+    base->next = bases;
+    bases = base;
+    pthread_mutex_unlock(&bases_lock);
+    return base;
 }
 
-void editorDrawMessageBar(struct abuf *ab){
-    //clears message bar
-    abAppend(ab, "\x1b[K", 3);
-    int msglen = strlen(E.statusmsg);
-    if (msglen > E.screencols) 
-        msglen = E.screencols;
-    if (msglen && time(NULL) - E.statusmsg_time < 5)
-        abAppend(ab, E.statusmsg, msglen);
+void editorBaseRelease(struct editorBase *base) {
+    if (base == NULL)
+        return;
+    pthread_mutex_lock(&bases_lock);
+    if (--base->refs > 0) {
+        pthread_mutex_unlock(&bases_lock);
+        return;
+    }
+    struct editorBase **p = &bases;
+    while (*p != base)
+        p = &(*p)->next;
+    *p = base->next;
+    pthread_mutex_unlock(&bases_lock);
+    free(base->path);
+    free(base->data);
+    if (base->cache_map) {
+        munmap(base->cache_map, base->cache_maplen);
+    } else {
+        free(base->lineoff);
+        free(base->linelen);
+        free(base->blooms);
+    }
+    free(base);
+}
+
+//looks at the first bytes of a file (its magic number) to know if it is compressed
+int editorDetectCompression(char *filename) {
+    unsigned char magic[4];
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+        return COMP_NONE;
+    ssize_t n = read(fd, magic, sizeof(magic));
+    close(fd);
+    if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+        return COMP_GZIP;
+    if (n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+        return COMP_ZSTD;
+    return COMP_NONE;
+}
+
+//a range of rows being filled from the line table of a file
+struct rowRange {
+    erow *row;
+    struct editorBase *base;
+    int from, to;
+    struct rowTable *table; //its entries are filled too, unless NULL
+};
+
+void *editorFillRows(void *arg) {
+    struct rowRange *r = arg;
+    int j;
+    for (j = r->from; j < r->to; j++) {
+        erow *row = &r->row[j];
+        row->chars = &r->base->data[r->base->lineoff[j]];
+        row->size = r->base->linelen[j];
+        row->borrowed = 1;
+        row->version = 0;
+        row->render = NULL;
+        row->rsize = 0;
+        row->hl = NULL;
+        row->fields = NULL;
+        row->hl_open_comment = 0;
+        row->hl_in_comment = -1;
+        if (r->table) {
+            struct snapRow *entry = &r->table->chunks[j / table_chunk]->rows[j % table_chunk];
+            entry->chars = row->chars;
+            entry->size = row->size;
+        }
+    }
+    return NULL;
+}
+
+/*editorOpen() takes a filename and loads it into the current buffer. The rows 
+borrow their chars from the shared storage of the file, so nothing is copied. 
+Returns -1 with errno set if the file can't be read*/
+int editorOpen(char *filename) {
+    //compressed files are decompressed in the background instead
+    int compression = editorDetectCompression(filename);
+    if (compression != COMP_NONE)
+        return editorOpenCompressed(filename, compression);
+
+    struct editorBase *base = editorBaseAcquire(filename);
+    //! is changing base from nonzero statement to zero and vice-versa
+    if (!base)
+        return -1;
+
+    free(E.filename);
+    // strdup() makes a copy of the given string (filename)
+    //it alocates the required memory assuming you will free() it 
+    E.filename = strdup(filename);
+
+    editorSelectSyntaxHighlight();
+    editorColumnsAuto();
+
+    editorBaseRelease(E.base);
+    E.base = base;
+
+    //all the rows are added at once, instead of one editorInsertRow() per line
+    E.row = realloc(E.row, sizeof(erow) * (E.numrows + base->numlines));
+    int nthreads = editorThreadsFor(base->numlines, KILO_ROWS_MIN);
+    struct rowRange ranges[KILO_MAX_THREADS];
+    //the row table of an empty buffer is filled by the same threads
+    int fresh = (E.numrows == 0);
+    if (fresh) {
+        editorTableFree(&E.table);
+        editorTableReserve(base->numlines);
+    }
+    int j;
+    for (j = 0; j < nthreads; j++) {
+        ranges[j].row = &E.row[E.numrows];
+        ranges[j].base = base;
+        ranges[j].table = fresh ? &E.table : NULL;
+        ranges[j].from = base->numlines / nthreads * j;
+        ranges[j].to = (j == nthreads - 1) ? base->numlines : base->numlines / nthreads * (j + 1);
+    }
+    editorRunParallel(editorFillRows, ranges, sizeof(struct rowRange), nthreads);
+    if (!fresh)
+        editorTableInsert(E.numrows, base->numlines);
+    //the blocks of base can only be used for searches if the rows start at its first line
+    if (E.numrows == 0)
+        E.pristine_rows = base->numlines;
+    E.numrows += base->numlines;
+
+    //follow mode continues reading from the end of what was loaded
+    E.file_offset = base->len;
+    E.file_lastbyte = base->len ? base->data[base->len - 1] : '\0';
+    E.file_partial = base->len && base->data[base->len - 1] != '\n';
+    E.file_ino = base->ino;
+    E.dirty = 0;
+    return 0;
+}
+
+//writes len bytes of buf to filename, returns -1 with errno set if it fails
+int editorWriteRaw(char *filename, char *buf, size_t len) {
+    // O_CREAT creates a new file if it doesn't already existis
+    // O_RDWR opens for read and writing 
+    /*" 0644 is the standard permissions you usually want for text files.
+    It gives the owner of the file permission to read and write the file, 
+    and everyone else only gets permission to read the file"*/
+    int fd = open(filename, O_RDWR | O_CREAT, 0644);
+    if (fd == -1)
+        return -1;
+    /*"The normal way to overwrite a file is to pass the O_TRUNC 
+    flag to open(), which truncates the file completely, making 
+    it an empty file, before writing the new data into it. By 
+    truncating the file ourselves to the same length as the data 
+    we are planning to write into it, we are making the whole overwriting 
+    operation a little bit safer in case the ftruncate() call succeeds but the write() call fails. "*/
+    if (ftruncate(fd, len) == -1) { //truncates the size of the file
+        close(fd);
+        return -1;
+    }
+    //write() can write less than it was asked to, so it is called until everything is written
+    size_t written = 0;
+    while (written < len) {
+        ssize_t n = write(fd, &buf[written], len - written);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            int saved_errno = errno;
+            close(fd);
+            errno = saved_errno;
+            return -1;
+        }
+        written += n;
+    }
+    return close(fd);
+}
+
+//like editorWriteRaw(), but the data is compressed first unless compression is COMP_NONE
+int editorWriteFile(char *filename, int compression, char *buf, size_t len) {
+    if (compression == COMP_NONE)
+        return editorWriteRaw(filename, buf, len);
+
+    char *out;
+    size_t outlen;
+    if (editorCompress(compression, buf, len, &out, &outlen) == -1)
+        return -1;
+    int rc = editorWriteRaw(filename, out, outlen);
+    free(out);
+    return rc;
+}
+
+//writev() called until all the pieces are written, returns -1 with errno set if it fails
+int editorWritevAll(int fd, struct iovec *iov, int cnt) {
+    while (cnt > 0) {
+        ssize_t n = writev(fd, iov, cnt);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        //skips what was written, which can end in the middle of a piece
+        while (cnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+/*writes the rows of a snapshot to filename straight from their chars, 
+without joining them in one buffer first (unless they are compressed)*/
+int editorWriteSnapshot(char *filename, int compression, struct editorSnapshot *snap, size_t *written) {
+    size_t len = 0;
+    int j, c;
+    struct rowTable *t = &snap->table;
+    //the chunks are read in order, without looking rows up one by one
+    for (c = 0; c < t->numchunks; c++) {
+        for (j = 0; j < t->chunks[c]->count; j++)
+            len += t->chunks[c]->rows[j].size + 1;
+    }
+    *written = len;
+
+    if (compression != COMP_NONE) {
+        char *buf = malloc(len + 1);
+        char *p = buf;
+        for (c = 0; c < t->numchunks; c++) {
+            for (j = 0; j < t->chunks[c]->count; j++) {
+                struct snapRow *row = &t->chunks[c]->rows[j];
+                memcpy(p, row->chars, row->size);
+                p += row->size;
+                *p++ = '\n';
+            }
+        }
+        int rc = editorWriteFile(filename, compression, buf, len);
+        int saved_errno = errno;
+        free(buf);
+        errno = saved_errno;
+        return rc;
+    }
+
+    int fd = open(filename, O_RDWR | O_CREAT, 0644);
+    if (fd == -1)
+        return -1;
+    //truncated to the final size first, like in editorWriteRaw()
+    int rc = ftruncate(fd, len);
+    struct iovec iov[KILO_IOV_MAX];
+    int cnt = 0;
+    int hint = 0;
+    for (j = 0; j < snap->numrows && rc == 0; j++) {
+        struct snapRow *row = editorSnapRow(snap, j, &hint);
+        //empty pieces are left out, writev() returning 0 would look like an error
+        if (row->size > 0) {
+            iov[cnt].iov_base = row->chars;
+            iov[cnt].iov_len = row->size;
+            cnt++;
+        }
+        iov[cnt].iov_base = "\n";
+        iov[cnt].iov_len = 1;
+        cnt++;
+        if (cnt >= KILO_IOV_MAX - 1 || j == snap->numrows - 1) {
+            rc = editorWritevAll(fd, iov, cnt);
+            cnt = 0;
+        }
+    }
+    if (rc == -1) {
+        int saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+        return -1;
+    }
+    return close(fd);
+}
+
+void *editorSaveThread(void *arg) {
+    struct editorSaveJob *job = arg;
+    job->rc = editorWriteSnapshot(job->filename, job->compression, job->snap, &job->len);
+    job->error = errno;
+    job->done = 1;
+    return NULL;
+}
+
+/*reports the end of the save of the current buffer, waiting for it if wait 
+is set. Returns 1 if a save ended*/
+int editorSavePoll(int wait) {
+    struct editorSaveJob *job = E.saving;
+    if (job == NULL || (!job->done && !wait))
+        return 0;
+    if (job->threaded)
+        pthread_join(job->thread, NULL);
+    E.saving = NULL;
+    if (job->rc == -1) {
+        editorSetStatusMessage("Can't save! I/O error: %s", strerror(job->error));
+    } else {
+        //edits made while it was being saved are not on disk
+        if (E.dirty == job->dirty)
+            E.dirty = 0;
+        editorSetStatusMessage("%zu bytes written to disk", job->len);
+        //the diff view compares with what was just written now
+        struct editorBase *disk = E.diff ? editorBaseAcquire(job->filename) : NULL;
+        if (disk) {
+            editorBaseRelease(E.diff->disk);
+            E.diff->disk = disk;
+            editorDiffCompute(E.diff);
+        }
+    }
+    editorSnapshotRelease(job->snap);
+    free(job->filename);
+    free(job);
+    return 1;
+}
+
+/*saves a snapshot of the current buffer in a thread, so saving a big file 
+doesn't stop the typing. editorIdle() reports when it is done*/
+void editorSaveStart() {
+    struct editorSaveJob *job = calloc(1, sizeof(struct editorSaveJob));
+    job->snap = editorSnapshotTake();
+    job->filename = strdup(E.filename);
+    job->compression = E.compression;
+    job->dirty = E.dirty;
+    E.saving = job;
+    job->threaded = (pthread_create(&job->thread, NULL, editorSaveThread, job) == 0);
+    if (!job->threaded) {
+        editorSaveThread(job);
+        editorSavePoll(0);
+        return;
+    }
+    editorSetStatusMessage("Saving %s...", E.filename);
+}
+
+void editorSave() {
+    if (E.saving) {
+        editorSetStatusMessage("Still saving, try again when it is done");
+        return;
+    }
+    /*Note: If you’re using Bash on Windows, you will have to press Escape 3 
+    times to get one Escape keypress to register in our program, because the 
+    read() calls in editorReadKey() that look for an escape sequence never time out*/
+    if (E.filename == NULL) { //this means it is a new file
+        E.filename = editorPrompt("Save as: %s (Esc to cancel)", NULL);
+        //the file will not be null anymore if 
+        if (E.filename == NULL) {
+            editorSetStatusMessage("save aborted");
+            return;
+        }
+        //a new file is compressed the way its name says
+        E.compression = editorCompressionOfName(E.filename);
+        editorSelectSyntaxHighlight();
+    }
+    //after a jump into a compressed file, the rows before it were never loaded
+    if (E.view_start > 0 || E.decoder) {
+        editorSetStatusMessage("Can't save! The file is %s", E.decoder ? "still loading" : "only partially loaded");
+        return;
+    }
+    //E.dirty goes back to 0 when it is done, so the modified code is not "dirty" anymore
+    editorSaveStart();
+}
+
+//FOLLOW//
+/*turns bytes appended to the followed file into rows. A line without its 
+newline yet is kept as the last row and the next data continues it*/
+void editorFollowAppend(char *buf, size_t len) {
+    //the rows come from the file, so they do not count as modifications
+    int dirty = E.dirty;
+    size_t start = 0;
+    while (start < len) {
+        char *nl = memchr(&buf[start], '\n', len - start);
+        size_t end = nl ? (size_t)(nl - buf) : len;
+        size_t linelen = end - start;
+        if (nl) {
+            while (linelen > 0 && buf[start + linelen - 1] == '\r')
+                linelen--;
+        }
+        if (E.file_partial && E.numrows > 0) {
+            erow *row = &E.row[E.numrows - 1];
+            editorRowAppendString(row, &buf[start], linelen);
+            //a "\r\n" can be split between two reads
+            if (nl && row->size > 0 && row->chars[row->size - 1] == '\r') {
+                row->size--;
+                row->chars[row->size] = '\0';
+                editorUpdateRow(row);
+            }
+        } else {
+            editorInsertRow(E.numrows, &buf[start], linelen);
+        }
+        E.file_partial = (nl == NULL);
+        start = end + 1;
+    }
+    E.dirty = dirty;
+}
+
+//reads only the byte range appended after E.file_offset, returns 1 if anything changed
+int editorFollowRead() {
+    struct stat st;
+    if (fstat(E.follow_fd, &st) == -1)
+        return 0;
+
+    int changed = 0;
+    /*a file smaller than what was read was truncated, the rows already 
+    loaded are kept and reading starts again from the top (like tail -f). 
+    If it already grew back past the offset, the last byte read tells it*/
+    char last;
+    if (st.st_size < E.file_offset || (E.file_offset > 0 && st.st_size > E.file_offset &&
+        (pread(E.follow_fd, &last, 1, E.file_offset - 1) != 1 || last != E.file_lastbyte))) {
+        E.file_offset = 0;
+        E.file_partial = 0;
+        editorSetStatusMessage("%s was truncated", E.filename);
+        changed = 1;
+    }
+
+    char buf[65536];
+    while (E.file_offset < st.st_size) {
+        size_t want = sizeof(buf);
+        if ((off_t)want > st.st_size - E.file_offset)
+            want = st.st_size - E.file_offset;
+        //pread() reads at an offset without moving the file position
+        ssize_t n = pread(E.follow_fd, buf, want, E.file_offset);
+        if (n <= 0)
+            break;
+        editorFollowAppend(buf, n);
+        E.file_offset += n;
+        E.file_lastbyte = buf[n - 1];
+        changed = 1;
+    }
+    return changed;
+}
+
+void editorFollowWatch() {
+    if (E.inotify_fd == -1)
+        return;
+    if (E.follow_wd != -1)
+        inotify_rm_watch(E.inotify_fd, E.follow_wd);
+    E.follow_wd = inotify_add_watch(E.inotify_fd, E.filename,
+        IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF);
+    if (E.follow_dirwd == -1) {
+        //dirname() may modify its argument, so it gets a copy
+        char *path = strdup(E.filename);
+        E.follow_dirwd = inotify_add_watch(E.inotify_fd, dirname(path), IN_CREATE | IN_MOVED_TO);
+        free(path);
+    }
+}
+
+/*when E.filename points to another file (rotation), the rest of the old file 
+is drained and the new one is followed from its start*/
+int editorFollowCheckRotation() {
+    struct stat st;
+    if (stat(E.filename, &st) == -1 || st.st_ino == E.file_ino)
+        return 0;
+
+    editorFollowRead();
+    int fd = open(E.filename, O_RDONLY);
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        if (fd != -1)
+            close(fd);
+        return 0;
+    }
+    close(E.follow_fd);
+    E.follow_fd = fd;
+    E.file_ino = st.st_ino;
+    E.file_offset = 0;
+    E.file_partial = 0;
+    editorFollowWatch();
+    editorSetStatusMessage("%s was rotated, following the new file", E.filename);
+    return 1;
+}
+
+void editorFollowStop() {
+    if (E.inotify_fd != -1)
+        close(E.inotify_fd); //closing it removes all of its watches
+    if (E.follow_fd != -1)
+        close(E.follow_fd);
+    E.inotify_fd = -1;
+    E.follow_fd = -1;
+    E.follow_wd = -1;
+    E.follow_dirwd = -1;
+    E.follow = 0;
+}
+
+//called when nothing was typed, returns 1 if the screen has to be redrawn
+int editorFollowPoll() {
+    if (!E.follow)
+        return 0;
+    //without inotify the file is checked on every poll instead
+    if (E.inotify_fd != -1) {
+        char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+        int events = 0;
+        //the events only say that something happened, so they are just drained
+        while (read(E.inotify_fd, buf, sizeof(buf)) > 0)
+            events = 1;
+        if (!events)
+            return 0;
+    }
+
+    //the view stays at the bottom unless the cursor was moved away from the last row
+    int pinned = (E.cy >= E.numrows - 1);
+    int changed = editorFollowCheckRotation();
+    changed |= editorFollowRead();
+    if (changed && pinned) {
+        E.cy = E.numrows > 0 ? E.numrows - 1 : 0;
+        E.cx = 0;
+    }
+    return changed;
+}
+
+void editorFollowStart() {
+    if (E.filename == NULL) {
+        editorSetStatusMessage("No file to follow");
+        return;
+    }
+    if (E.compression != COMP_NONE) {
+        editorSetStatusMessage("Can't follow a compressed file");
+        return;
+    }
+    E.follow_fd = open(E.filename, O_RDONLY);
+    struct stat st;
+    if (E.follow_fd == -1 || fstat(E.follow_fd, &st) == -1) {
+        editorSetStatusMessage("Can't follow! I/O error: %s", strerror(errno));
+        editorFollowStop();
+        return;
+    }
+    //the file was replaced since it was opened, so the new one is read from its start
+    if (st.st_ino != E.file_ino) {
+        E.file_ino = st.st_ino;
+        E.file_offset = 0;
+        E.file_partial = 0;
+    }
+    E.follow = 1;
+    E.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    editorFollowWatch();
+
+    //catches up with what was written since the file was opened
+    editorFollowRead();
+    E.cy = E.numrows > 0 ? E.numrows - 1 : 0;
+    E.cx = 0;
+    editorSetStatusMessage("Following %s (Ctrl-T to stop)", E.filename);
+}
+
+//COMPRESSION//
+int editorCompressionOfName(char *filename) {
+    char *ext = strrchr(filename, '.');
+    if (ext && !strcmp(ext, ".gz"))
+        return COMP_GZIP;
+    if (ext && !strcmp(ext, ".zst"))
+        return COMP_ZSTD;
+    return COMP_NONE;
+}
+
+uint32_t editorReadLE32(unsigned char *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void editorWriteLE32(unsigned char *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+void editorFreeFrameIndex(struct editorFrameIndex *fi) {
+    if (fi == NULL)
+        return;
+    free(fi->coff);
+    free(fi->doff);
+    free(fi);
+}
+
+/*a seekable zstd file ends with a skippable frame holding the compressed and 
+decompressed size of every frame. The footer (its last 9 bytes) is the number 
+of frames, a descriptor (bit 7 means each entry has a checksum, bits 2-6 are 
+reserved) and a magic. Anything that doesn't add up returns NULL, and the file 
+is only decoded from the start*/
+struct editorFrameIndex *editorReadFrameIndex(int fd) {
+    struct stat st;
+    unsigned char footer[9];
+    if (fstat(fd, &st) == -1 || st.st_size < 17 ||
+        pread(fd, footer, sizeof(footer), st.st_size - 9) != 9 ||
+        editorReadLE32(&footer[5]) != 0x8F92EAB1 || (footer[4] & 0x7C))
+        return NULL;
+
+    uint32_t numframes = editorReadLE32(footer);
+    int entrysize = (footer[4] & 0x80) ? 12 : 8;
+    //the table, plus the footer and the header of the skippable frame
+    off_t tablesize = (off_t)numframes * entrysize;
+    if (numframes == 0 || tablesize + 9 + 8 > st.st_size)
+        return NULL;
+    //the header of the skippable frame: its magic and the size of what follows
+    off_t framestart = st.st_size - 9 - tablesize - 8;
+    unsigned char header[8];
+    if (pread(fd, header, sizeof(header), framestart) != 8 ||
+        editorReadLE32(header) != 0x184D2A5E || editorReadLE32(&header[4]) != tablesize + 9)
+        return NULL;
+    unsigned char *table = malloc(tablesize);
+    if (pread(fd, table, tablesize, st.st_size - 9 - tablesize) != tablesize) {
+        free(table);
+        return NULL;
+    }
+
+    struct editorFrameIndex *fi = malloc(sizeof(struct editorFrameIndex));
+    fi->numframes = numframes;
+    fi->coff = malloc(sizeof(off_t) * (numframes + 1));
+    fi->doff = malloc(sizeof(off_t) * (numframes + 1));
+    fi->coff[0] = 0;
+    fi->doff[0] = 0;
+    uint32_t j;
+    for (j = 0; j < numframes; j++) {
+        fi->coff[j + 1] = fi->coff[j] + editorReadLE32(&table[j * entrysize]);
+        fi->doff[j + 1] = fi->doff[j] + editorReadLE32(&table[j * entrysize + 4]);
+    }
+    free(table);
+    //the frames come one after the other, right up to the seek table
+    if (fi->coff[numframes] != framestart) {
+        editorFreeFrameIndex(fi);
+        return NULL;
+    }
+    return fi;
+}
+
+/*compresses buf into *out (allocated here). zstd is written as independent 
+frames with a seek table at the end, so the file can be jumped into later*/
+int editorCompress(int compression, char *buf, size_t len, char **out, size_t *outlen) {
+#ifdef KILO_ZLIB
+    if (compression == COMP_GZIP) {
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        //15 + 16 means a 32KB window with a gzip header
+        if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            errno = ENOMEM;
+            return -1;
+        }
+        size_t cap = deflateBound(&zs, len);
+        *out = malloc(cap);
+        int rc = Z_OK;
+        /*avail_in and avail_out are 32 bits, so a bigger buffer is given in 
+        pieces, and Z_FINISH only with the last of it*/
+        while (rc == Z_OK) {
+            size_t inleft = len - zs.total_in;
+            if (zs.total_out == cap) {
+                cap *= 2;
+                *out = realloc(*out, cap);
+            }
+            size_t outleft = cap - zs.total_out;
+            zs.next_in = (unsigned char *)&buf[zs.total_in];
+            zs.avail_in = inleft < UINT_MAX ? inleft : UINT_MAX;
+            zs.next_out = (unsigned char *)&(*out)[zs.total_out];
+            zs.avail_out = outleft < UINT_MAX ? outleft : UINT_MAX;
+            rc = deflate(&zs, zs.avail_in == inleft ? Z_FINISH : Z_NO_FLUSH);
+        }
+        *outlen = zs.total_out;
+        deflateEnd(&zs);
+        if (rc != Z_STREAM_END) {
+            free(*out);
+            errno = EIO;
+            return -1;
+        }
+        return 0;
+    }
+#endif
+#ifdef KILO_ZSTD
+    if (compression == COMP_ZSTD) {
+        size_t numframes = (len + KILO_ZSTD_FRAME - 1) / KILO_ZSTD_FRAME;
+        size_t tablesize = numframes * 8 + 9;
+        size_t cap = numframes * ZSTD_compressBound(KILO_ZSTD_FRAME) + ZSTD_compressBound(0) + 8 + tablesize;
+        *out = malloc(cap);
+        unsigned char *table = malloc(tablesize);
+        ZSTD_CCtx *cctx = ZSTD_createCCtx();
+        size_t pos = 0;
+        size_t j;
+        //an empty file is still one (empty) frame
+        if (len == 0)
+            pos = ZSTD_compressCCtx(cctx, *out, cap, buf, 0, 3);
+        for (j = 0; j < numframes; j++) {
+            size_t srclen = (j == numframes - 1) ? len - j * KILO_ZSTD_FRAME : KILO_ZSTD_FRAME;
+            size_t n = ZSTD_compressCCtx(cctx, &(*out)[pos], cap - pos, &buf[j * KILO_ZSTD_FRAME], srclen, 3);
+            if (ZSTD_isError(n)) {
+                pos = n;
+                break;
+            }
+            editorWriteLE32(&table[j * 8], n);
+            editorWriteLE32(&table[j * 8 + 4], srclen);
+            pos += n;
+        }
+        ZSTD_freeCCtx(cctx);
+        if (ZSTD_isError(pos)) {
+            free(table);
+            free(*out);
+            errno = EIO;
+            return -1;
+        }
+        //the seek table goes in a skippable frame, which decoders ignore
+        unsigned char *p = (unsigned char *)&(*out)[pos];
+        editorWriteLE32(p, 0x184D2A5E);
+        editorWriteLE32(&p[4], tablesize);
+        editorWriteLE32(&table[numframes * 8], numframes);
+        table[numframes * 8 + 4] = 0;
+        editorWriteLE32(&table[numframes * 8 + 5], 0x8F92EAB1);
+        memcpy(&p[8], table, tablesize);
+        free(table);
+        *outlen = pos + 8 + tablesize;
+        return 0;
+    }
+#endif
+    (void)buf;
+    (void)len;
+    (void)out;
+    (void)outlen;
+    (void)compression;
+    errno = ENOTSUP;
+    return -1;
+}
+
+//hands decompressed data to the main thread
+void editorDecoderOutput(struct editorDecoder *d, char *buf, size_t len) {
+    if (len == 0)
+        return;
+    pthread_mutex_lock(&d->lock);
+    //without a thread (joined from the start) nobody would drain it
+    while (d->pendlen >= KILO_PENDING_MAX && !d->cancel && !d->joined)
+        pthread_cond_wait(&d->cond, &d->lock);
+    if (d->pendlen + len > d->pendcap) {
+        d->pendcap = (d->pendlen + len) * 2;
+        d->pending = realloc(d->pending, d->pendcap);
+    }
+    memcpy(&d->pending[d->pendlen], buf, len);
+    d->pendlen += len;
+    pthread_cond_broadcast(&d->cond);
+    pthread_mutex_unlock(&d->lock);
+}
+
+//reads the compressed file, returns 0 at the end or -1
+ssize_t editorDecoderRead(struct editorDecoder *d, void *buf, size_t len) {
+    ssize_t n;
+    while ((n = read(d->fd, buf, len)) == -1 && errno == EINTR)
+        ;
+    if (n == -1)
+        snprintf(d->error, sizeof(d->error), "%s", strerror(errno));
+    return n;
+}
+
+#ifdef KILO_ZLIB
+void editorInflate(struct editorDecoder *d) {
+    unsigned char in[65536];
+    unsigned char out[262144];
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    //15 + 32 detects a gzip or a zlib header
+    if (inflateInit2(&zs, 15 + 32) != Z_OK) {
+        snprintf(d->error, sizeof(d->error), "out of memory");
+        return;
+    }
+    int rc = Z_OK;
+    int members = 0;
+    while (!d->cancel) {
+        if (zs.avail_in == 0) {
+            ssize_t n = editorDecoderRead(d, in, sizeof(in));
+            if (n <= 0)
+                break;
+            zs.next_in = in;
+            zs.avail_in = n;
+        }
+        zs.next_out = out;
+        zs.avail_out = sizeof(out);
+        rc = inflate(&zs, Z_NO_FLUSH);
+        if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) {
+            //garbage after a complete member (like padding) is ignored
+            if (members == 0)
+                snprintf(d->error, sizeof(d->error), "corrupt gzip data");
+            rc = Z_STREAM_END;
+            break;
+        }
+        editorDecoderOutput(d, (char *)out, sizeof(out) - zs.avail_out);
+        //a gzip file can be several members one after the other
+        if (rc == Z_STREAM_END) {
+            members++;
+            inflateReset(&zs);
+        }
+    }
+    if (rc != Z_STREAM_END && !d->cancel && !d->error[0])
+        snprintf(d->error, sizeof(d->error), "gzip data is truncated");
+    inflateEnd(&zs);
+}
+#endif
+
+#ifdef KILO_ZSTD
+void editorZstdDecode(struct editorDecoder *d) {
+    char in[65536];
+    char out[262144];
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    //0 means the last frame was complete
+    size_t ret = 0;
+    while (!d->cancel) {
+        ssize_t n = editorDecoderRead(d, in, sizeof(in));
+        if (n <= 0)
+            break;
+        ZSTD_inBuffer input = { in, n, 0 };
+        ZSTD_outBuffer output;
+        //skippable frames (like the seek table) are skipped by the decoder itself
+        do {
+            output.dst = out;
+            output.size = sizeof(out);
+            output.pos = 0;
+            ret = ZSTD_decompressStream(dctx, &output, &input);
+            if (ZSTD_isError(ret)) {
+                snprintf(d->error, sizeof(d->error), "%s", ZSTD_getErrorName(ret));
+                ZSTD_freeDCtx(dctx);
+                return;
+            }
+            editorDecoderOutput(d, out, output.pos);
+        } while (input.pos < input.size || output.pos == output.size);
+    }
+    if (ret != 0 && !d->cancel && !d->error[0])
+        snprintf(d->error, sizeof(d->error), "zstd data is truncated");
+    ZSTD_freeDCtx(dctx);
+}
+#endif
+
+void *editorDecodeThread(void *arg) {
+    struct editorDecoder *d = arg;
+    if (lseek(d->fd, d->start, SEEK_SET) == -1) {
+        snprintf(d->error, sizeof(d->error), "%s", strerror(errno));
+    } else {
+#ifdef KILO_ZLIB
+        if (d->compression == COMP_GZIP)
+            editorInflate(d);
+#endif
+#ifdef KILO_ZSTD
+        if (d->compression == COMP_ZSTD)
+            editorZstdDecode(d);
+#endif
+    }
+    pthread_mutex_lock(&d->lock);
+    d->done = 1;
+    pthread_cond_broadcast(&d->cond);
+    pthread_mutex_unlock(&d->lock);
+    return NULL;
+}
+
+//starts decompressing fd from start (an offset in the compressed data) into the current buffer
+void editorDecodeStart(int fd, off_t start) {
+    struct editorDecoder *d = calloc(1, sizeof(struct editorDecoder));
+    pthread_mutex_init(&d->lock, NULL);
+    pthread_cond_init(&d->cond, NULL);
+    d->fd = fd;
+    d->compression = E.compression;
+    d->start = start;
+    E.decoder = d;
+    E.file_partial = 0;
+    if (pthread_create(&d->thread, NULL, editorDecodeThread, d) != 0) {
+        //without a thread it is decompressed right here
+        d->joined = 1;
+        editorDecodeThread(d);
+    }
+}
+
+/*turns what was decompressed since the last call into rows, returns 1 if the 
+screen has to be redrawn*/
+int editorDecodePoll() {
+    struct editorDecoder *d = E.decoder;
+    if (d == NULL)
+        return 0;
+
+    //the data is taken out under the lock, then turned into rows without it
+    pthread_mutex_lock(&d->lock);
+    char *buf = d->pending;
+    size_t len = d->pendlen;
+    int done = d->done;
+    d->pending = NULL;
+    d->pendlen = 0;
+    d->pendcap = 0;
+    pthread_cond_broadcast(&d->cond);
+    pthread_mutex_unlock(&d->lock);
+
+    if (len)
+        editorFollowAppend(buf, len);
+    free(buf);
+
+    if (done) {
+        if (!d->joined)
+            pthread_join(d->thread, NULL);
+        if (d->error[0])
+            editorSetStatusMessage("%s: %s", E.filename, d->error);
+        close(d->fd);
+        pthread_mutex_destroy(&d->lock);
+        pthread_cond_destroy(&d->cond);
+        free(d);
+        E.decoder = NULL;
+    }
+    return len > 0 || done;
+}
+
+//waits until the whole file is decompressed, returns -1 if it failed (see E.statusmsg)
+int editorDecodeFinish() {
+    int rc = 0;
+    //the thread waits while pending is full, so it is drained until the thread is done
+    while (E.decoder) {
+        struct editorDecoder *d = E.decoder;
+        pthread_mutex_lock(&d->lock);
+        while (d->pendlen == 0 && !d->done)
+            pthread_cond_wait(&d->cond, &d->lock);
+        if (d->done && d->error[0])
+            rc = -1;
+        pthread_mutex_unlock(&d->lock);
+        editorDecodePoll();
+    }
+    return rc;
+}
+
+//stops decompressing, what was not turned into rows yet is thrown away
+void editorDecodeStop() {
+    struct editorDecoder *d = E.decoder;
+    if (d == NULL)
+        return;
+    //under the lock, so a thread waiting for pending to be drained sees it
+    pthread_mutex_lock(&d->lock);
+    d->cancel = 1;
+    pthread_cond_broadcast(&d->cond);
+    pthread_mutex_unlock(&d->lock);
+    editorDecodeFinish();
+}
+
+/*opens a compressed file into the current buffer. It returns right away, the 
+rows show up as a thread decompresses the file*/
+int editorOpenCompressed(char *filename, int compression) {
+#ifndef KILO_ZLIB
+    if (compression == COMP_GZIP) {
+        errno = ENOTSUP;
+        return -1;
+    }
+#endif
+#ifndef KILO_ZSTD
+    if (compression == COMP_ZSTD) {
+        errno = ENOTSUP;
+        return -1;
+    }
+#endif
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+        return -1;
+
+    free(E.filename);
+    E.filename = strdup(filename);
+    editorSelectSyntaxHighlight();
+    editorColumnsAuto();
+    E.compression = compression;
+    editorFreeFrameIndex(E.frames);
+    E.frames = (compression == COMP_ZSTD) ? editorReadFrameIndex(fd) : NULL;
+    E.view_start = 0;
+    editorDecodeStart(fd, 0);
+    E.dirty = 0;
+    return 0;
+}
+
+/*shows a seekable zstd file from the frame holding the given percent of its 
+decompressed data, without decompressing anything before that frame*/
+void editorDecodeJump(int percent) {
+    struct editorFrameIndex *fi = E.frames;
+    if (fi == NULL || fi->numframes == 0) {
+        editorSetStatusMessage("Only seekable zstd files can be jumped into");
+        return;
+    }
+    if (E.dirty) {
+        editorSetStatusMessage("Can't jump, the buffer has unsaved changes");
+        return;
+    }
+    int fd = open(E.filename, O_RDONLY);
+    if (fd == -1) {
+        editorSetStatusMessage("Can't jump! I/O error: %s", strerror(errno));
+        return;
+    }
+
+    if (percent < 0)
+        percent = 0;
+    if (percent > 100)
+        percent = 100;
+    off_t target = fi->doff[fi->numframes] * percent / 100;
+    //binary search of the last frame starting at or before target
+    int lo = 0, hi = fi->numframes - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (fi->doff[mid] <= target)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    editorDecodeStop();
+    editorRowsChanged(0);
+    int j;
+    for (j = 0; j < E.numrows; j++)
+        editorFreeRow(&E.row[j]);
+    E.numrows = 0;
+    editorTableFree(&E.table);
+    E.cx = 0;
+    E.cy = 0;
+    E.rowoff = 0;
+    E.coloff = 0;
+    E.view_start = fi->doff[lo];
+    editorDecodeStart(fd, fi->coff[lo]);
+    E.dirty = 0;
+    editorSetStatusMessage("Showing %s from byte %lld (frame %d of %d)", E.filename,
+        (long long)E.view_start, lo + 1, fi->numframes);
+}
+
+//BUFFERS//
+//saves the state of the current buffer into b
+void editorBufferStash(struct editorBuffer *b) {
+    b->cx = E.cx;
+    b->cy = E.cy;
+    b->rx = E.rx;
+    b->rowoff = E.rowoff;
+    b->coloff = E.coloff;
+    b->numrows = E.numrows;
+    b->row = E.row;
+    b->dirty = E.dirty;
+    b->filename = E.filename;
+    b->syntax = E.syntax;
+    b->base = E.base;
+    b->follow = E.follow;
+    b->follow_fd = E.follow_fd;
+    b->inotify_fd = E.inotify_fd;
+    b->follow_wd = E.follow_wd;
+    b->follow_dirwd = E.follow_dirwd;
+    b->file_offset = E.file_offset;
+    b->file_lastbyte = E.file_lastbyte;
+    b->file_ino = E.file_ino;
+    b->file_partial = E.file_partial;
+    b->compression = E.compression;
+    b->decoder = E.decoder;
+    b->frames = E.frames;
+    b->view_start = E.view_start;
+    b->pristine_rows = E.pristine_rows;
+    b->hl_valid = E.hl_valid;
+    b->table = E.table;
+    b->saving = E.saving;
+    b->id = E.id;
+    b->mark = E.mark;
+    b->mark_cx = E.mark_cx;
+    b->mark_cy = E.mark_cy;
+    b->diff = E.diff;
+    b->cols = E.cols;
+}
+
+//makes b the current buffer
+void editorBufferLoad(struct editorBuffer *b) {
+    E.cx = b->cx;
+    E.cy = b->cy;
+    E.rx = b->rx;
+    E.rowoff = b->rowoff;
+    E.coloff = b->coloff;
+    E.numrows = b->numrows;
+    E.row = b->row;
+    E.dirty = b->dirty;
+    E.filename = b->filename;
+    E.syntax = b->syntax;
+    E.base = b->base;
+    E.follow = b->follow;
+    E.follow_fd = b->follow_fd;
+    E.inotify_fd = b->inotify_fd;
+    E.follow_wd = b->follow_wd;
+    E.follow_dirwd = b->follow_dirwd;
+    E.file_offset = b->file_offset;
+    E.file_lastbyte = b->file_lastbyte;
+    E.file_ino = b->file_ino;
+    E.file_partial = b->file_partial;
+    E.compression = b->compression;
+    E.decoder = b->decoder;
+    E.frames = b->frames;
+    E.view_start = b->view_start;
+    E.pristine_rows = b->pristine_rows;
+    E.hl_valid = b->hl_valid;
+    E.table = b->table;
+    E.saving = b->saving;
+    E.id = b->id;
+    E.mark = b->mark;
+    E.mark_cx = b->mark_cx;
+    E.mark_cy = b->mark_cy;
+    E.diff = b->diff;
+    E.cols = b->cols;
+}
+
+//resets E to an empty buffer
+void editorInitBuffer() {
+    //setting x and y coordinates of the cursor relative to the text file
+    E.cx = 0; //horizontal index into the chars field of an erow
+    E.cy = 0; //vertical
+    E.rx = 0; //horizontal index into the render field of an erow
+    E.rowoff = 0; //starts at the top row
+    E.coloff = 0; //starts at the leftmost column
+    E.numrows = 0; //couonter starts at zero
+    E.row = NULL; //row depends of the generation of erow structs being attached to it
+    E.dirty = 0; //tracksif the text loaded differs from whats in the file (can warn for unsaved changes)
+    E.filename = NULL; //as long as the file is not opened, the value of E.filename is NULL
+    E.syntax = NULL; //no highlighting until a filetype is detected
+    E.base = NULL;
+    E.follow = 0;
+    E.follow_fd = -1;
+    E.inotify_fd = -1;
+    E.follow_wd = -1;
+    E.follow_dirwd = -1;
+    E.file_offset = 0;
+    E.file_lastbyte = '\0';
+    E.file_ino = 0;
+    E.file_partial = 0;
+    E.compression = COMP_NONE;
+    E.decoder = NULL;
+    E.frames = NULL;
+    E.view_start = 0;
+    E.pristine_rows = 0;
+    E.hl_valid = 0;
+    memset(&E.table, 0, sizeof(E.table));
+    E.saving = NULL;
+    E.id = ++E.lastid;
+    E.mark = MARK_OFF;
+    E.mark_cx = 0;
+    E.mark_cy = 0;
+    E.diff = NULL;
+    E.cols = NULL;
+}
+
+int editorAnyDirty() {
+    if (E.dirty)
+        return 1;
+    int j;
+    for (j = 0; j < E.numbuffers; j++) {
+        if (j != E.curbuf && E.buffers[j].dirty)
+            return 1;
+    }
+    return 0;
+}
+
+//waits for the saves still running, in every buffer
+void editorSaveWaitAll() {
+    editorSavePoll(1);
+    int j;
+    for (j = 0; j < E.numbuffers; j++) {
+        if (j == E.curbuf || !E.buffers[j].saving)
+            continue;
+        editorBufferStash(&E.buffers[E.curbuf]);
+        editorBufferLoad(&E.buffers[j]);
+        editorSavePoll(1);
+        editorBufferStash(&E.buffers[j]);
+        editorBufferLoad(&E.buffers[E.curbuf]);
+    }
+}
+
+//only the small per-buffer state is swapped, the rows stay where they are
+void editorSwitchBuffer(int to) {
+    if (to < 0 || to >= E.numbuffers || to == E.curbuf)
+        return;
+    editorBufferStash(&E.buffers[E.curbuf]);
+    editorBufferLoad(&E.buffers[to]);
+    E.curbuf = to;
+}
+
+//adds an empty buffer after the others and makes it the current one
+void editorNewBuffer() {
+    editorBufferStash(&E.buffers[E.curbuf]);
+    E.buffers = realloc(E.buffers, sizeof(struct editorBuffer) * (E.numbuffers + 1));
+    E.curbuf = E.numbuffers++;
+    editorInitBuffer();
+}
+
+void editorCloseBuffer() {
+    editorSavePoll(1);
+    if (E.clip.bufid == E.id)
+        editorClipMaterialize();
+    editorDiffClose();
+    editorColumnsOff();
+    if (E.follow)
+        editorFollowStop();
+    editorDecodeStop();
+    editorFreeFrameIndex(E.frames);
+    int j;
+    for (j = 0; j < E.numrows; j++)
+        editorFreeRow(&E.row[j]);
+    free(E.row);
+    editorTableFree(&E.table);
+    free(E.filename);
+    editorBaseRelease(E.base);
+
+    if (E.numbuffers == 1) {
+        editorInitBuffer();
+        return;
+    }
+    memmove(&E.buffers[E.curbuf], &E.buffers[E.curbuf + 1],
+        sizeof(struct editorBuffer) * (E.numbuffers - E.curbuf - 1));
+    E.numbuffers--;
+    if (E.curbuf == E.numbuffers)
+        E.curbuf--;
+    editorBufferLoad(&E.buffers[E.curbuf]);
+}
+
+//opens a file in a new buffer, a file already open in another buffer shares its storage
+void editorOpenBuffer() {
+    char *filename = editorPrompt("Open: %s (Esc to cancel)", NULL);
+    if (filename == NULL)
+        return;
+    int prev = E.curbuf;
+    editorNewBuffer();
+    if (editorOpen(filename) == -1) {
+        editorSetStatusMessage("Can't open %s: %s", filename, strerror(errno));
+        editorCloseBuffer();
+        editorSwitchBuffer(prev);
+    }
+    free(filename);
+}
+
+//CLIPBOARD//
+//a line of the clipboard with the chars of row from..to, borrowed ones are not copied
+erow editorClipSlice(erow *row, int from, int to) {
+    erow line;
+    memset(&line, 0, sizeof(line));
+    line.size = to - from;
+    if (row->borrowed) {
+        line.chars = &row->chars[from];
+        line.borrowed = 1;
+    } else {
+        line.chars = malloc(line.size + 1);
+        memcpy(line.chars, &row->chars[from], line.size);
+        line.chars[line.size] = '\0';
+        line.version = E.snap_version;
+    }
+    return line;
+}
+
+void editorClipFree() {
+    struct editorClipboard *c = &E.clip;
+    int j;
+    for (j = 0; j < c->numlines; j++)
+        editorRetireChars(&c->lines[j]);
+    free(c->lines);
+    c->lines = NULL;
+    c->numlines = 0;
+    c->bufid = 0;
+    editorBaseRelease(c->base);
+    c->base = NULL;
+}
+
+/*gives a copy its own lines, out of the rows it refers to. Only the chars 
+owned by the rows are copied, the ones borrowed from the file stay borrowed*/
+void editorClipMaterialize() {
+    struct editorClipboard *c = &E.clip;
+    if (!c->bufid)
+        return;
+    erow *rows = NULL;
+    int numrows = 0;
+    struct editorBase *base = NULL;
+    if (c->bufid == E.id) {
+        rows = E.row;
+        numrows = E.numrows;
+        base = E.base;
+    } else {
+        int j;
+        for (j = 0; j < E.numbuffers; j++) {
+            if (j != E.curbuf && E.buffers[j].id == c->bufid) {
+                rows = E.buffers[j].row;
+                numrows = E.buffers[j].numrows;
+                base = E.buffers[j].base;
+            }
+        }
+    }
+    c->bufid = 0;
+    if (rows == NULL || c->endrow >= numrows)
+        return;
+
+    c->numlines = c->endrow - c->startrow + 1;
+    c->lines = malloc(sizeof(erow) * c->numlines);
+    int j;
+    for (j = 0; j < c->numlines; j++) {
+        erow *row = &rows[c->startrow + j];
+        int from = (j == 0 && !c->linewise) ? c->startcol : 0;
+        int to = (j == c->numlines - 1 && !c->linewise) ? c->endcol : row->size;
+        if (to > row->size)
+            to = row->size;
+        if (from > to)
+            from = to;
+        c->lines[j] = editorClipSlice(row, from, to);
+    }
+    c->base = base;
+    if (base) {
+        pthread_mutex_lock(&bases_lock);
+        base->refs++;
+        pthread_mutex_unlock(&bases_lock);
+    }
+}
+
+//the selected range in order, returns MARK_OFF if there is none (the columns are not used with MARK_LINES)
+int editorSelection(int *r1, int *c1, int *r2, int *c2) {
+    if (E.mark == MARK_OFF || E.numrows == 0)
+        return MARK_OFF;
+    int ay = E.mark_cy, ax = E.mark_cx;
+    int by = E.cy, bx = E.cx;
+    if (ay > by || (ay == by && ax > bx)) {
+        int t;
+        t = ay; ay = by; by = t;
+        t = ax; ax = bx; bx = t;
+    }
+    //the line after the last row stands for the end of the last row
+    if (ay >= E.numrows) {
+        ay = E.numrows - 1;
+        ax = E.row[ay].size;
+    }
+    if (by >= E.numrows) {
+        by = E.numrows - 1;
+        bx = E.row[by].size;
+    }
+    if (ax > E.row[ay].size)
+        ax = E.row[ay].size;
+    if (bx > E.row[by].size)
+        bx = E.row[by].size;
+    *r1 = ay;
+    *c1 = ax;
+    *r2 = by;
+    *c2 = bx;
+    return E.mark;
+}
+
+/*sends the text of n rows (the first from firstcol, the last up to lastcol) to 
+the clipboard of the terminal with the OSC 52 escape sequence, which also works 
+over ssh. Only when $KILO_OSC52 is set, not every terminal understands it*/
+void editorOsc52(erow *rows, int n, int firstcol, int lastcol, int linewise) {
+    if (E.headless || getenv("KILO_OSC52") == NULL || n <= 0)
+        return;
+    size_t len = 0;
+    int j;
+    for (j = 0; j < n; j++) {
+        int from = (j == 0) ? firstcol : 0;
+        int to = (j == n - 1) ? lastcol : rows[j].size;
+        len += to - from + ((j < n - 1 || linewise) ? 1 : 0);
+    }
+    if (len > KILO_OSC52_MAX) {
+        editorSetStatusMessage("Not sent to the terminal clipboard, %zu bytes is too much", len);
+        return;
+    }
+    char *text = malloc(len + 1);
+    char *p = text;
+    for (j = 0; j < n; j++) {
+        int from = (j == 0) ? firstcol : 0;
+        int to = (j == n - 1) ? lastcol : rows[j].size;
+        memcpy(p, &rows[j].chars[from], to - from);
+        p += to - from;
+        if (j < n - 1 || linewise)
+            *p++ = '\n';
+    }
+
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char *out = malloc(16 + (len + 2) / 3 * 4);
+    size_t o = 0;
+    o += sprintf(out, "\x1b]52;c;");
+    size_t i;
+    for (i = 0; i < len; i += 3) {
+        unsigned int v = (unsigned char)text[i] << 16;
+        if (i + 1 < len)
+            v |= (unsigned char)text[i + 1] << 8;
+        if (i + 2 < len)
+            v |= (unsigned char)text[i + 2];
+        out[o++] = b64[(v >> 18) & 63];
+        out[o++] = b64[(v >> 12) & 63];
+        out[o++] = (i + 1 < len) ? b64[(v >> 6) & 63] : '=';
+        out[o++] = (i + 2 < len) ? b64[v & 63] : '=';
+    }
+    out[o++] = '\x07';
+    editorOutputWrite(out, o);
+    free(out);
+    free(text);
+}
+
+//Ctrl-B sets the mark, pressing it again selects whole lines and then removes it
+void editorMarkCycle() {
+    if (E.mark == MARK_OFF) {
+        E.mark = MARK_CHARS;
+        E.mark_cx = E.cx;
+        E.mark_cy = E.cy;
+        editorSetStatusMessage("Mark set (Ctrl-B again to select whole lines)");
+    } else if (E.mark == MARK_CHARS) {
+        E.mark = MARK_LINES;
+        editorSetStatusMessage("Selecting lines");
+    } else {
+        E.mark = MARK_OFF;
+        editorSetStatusMessage("Mark removed");
+    }
+}
+
+//the selection, or the cursor line without one. Returns MARK_OFF if there is nothing
+int editorClipRange(int *r1, int *c1, int *r2, int *c2) {
+    int mode = editorSelection(r1, c1, r2, c2);
+    if (mode == MARK_OFF && E.cy < E.numrows) {
+        *r1 = *r2 = E.cy;
+        *c1 = *c2 = 0;
+        mode = MARK_LINES;
+    }
+    return mode;
+}
+
+//the clipboard only remembers where the text is, nothing is copied yet
+void editorCopy() {
+    int r1, c1, r2, c2;
+    int mode = editorClipRange(&r1, &c1, &r2, &c2);
+    if (mode == MARK_OFF)
+        return;
+    editorClipFree();
+    struct editorClipboard *c = &E.clip;
+    c->linewise = (mode == MARK_LINES);
+    c->bufid = E.id;
+    c->startrow = r1;
+    c->startcol = c1;
+    c->endrow = r2;
+    c->endcol = c2;
+    E.mark = MARK_OFF;
+    editorSetStatusMessage("Copied %d line%s", r2 - r1 + 1, r2 > r1 ? "s" : "");
+    editorOsc52(&E.row[r1], r2 - r1 + 1, c->linewise ? 0 : c1,
+        c->linewise ? E.row[r2].size : c2, c->linewise);
+}
+
+//the rows cut are moved to the clipboard, only the partial rows at both ends are copied
+void editorCut() {
+    int r1, c1, r2, c2;
+    int mode = editorClipRange(&r1, &c1, &r2, &c2);
+    if (mode == MARK_OFF)
+        return;
+    editorClipFree();
+    struct editorClipboard *c = &E.clip;
+    int n = r2 - r1 + 1;
+    c->linewise = (mode == MARK_LINES);
+    c->numlines = n;
+    c->lines = malloc(sizeof(erow) * n);
+    c->base = E.base;
+    if (c->base) {
+        pthread_mutex_lock(&bases_lock);
+        c->base->refs++;
+        pthread_mutex_unlock(&bases_lock);
+    }
+
+    if (c->linewise) {
+        editorDelRows(r1, n, c->lines);
+        E.cy = r1;
+        E.cx = 0;
+    } else {
+        erow *first = &E.row[r1];
+        erow *last = &E.row[r2];
+        if (n == 1) {
+            c->lines[0] = editorClipSlice(first, c1, c2);
+        } else {
+            c->lines[0] = editorClipSlice(first, c1, first->size);
+            c->lines[n - 1] = editorClipSlice(last, 0, c2);
+        }
+        //what is left of the first and the last row becomes one row
+        int tail = last->size - c2;
+        char *joined = malloc(c1 + tail + 1);
+        memcpy(joined, first->chars, c1);
+        memcpy(&joined[c1], &last->chars[c2], tail);
+        if (n > 2)
+            editorDelRows(r1 + 1, n - 2, &c->lines[1]);
+        if (n > 1)
+            editorDelRow(r1 + 1);
+        editorRowSetString(&E.row[r1], joined, c1 + tail);
+        free(joined);
+        E.cy = r1;
+        E.cx = c1;
+    }
+    E.mark = MARK_OFF;
+    editorSetStatusMessage("Cut %d line%s", n, n > 1 ? "s" : "");
+    editorOsc52(c->lines, n, 0, c->lines[n - 1].size, c->linewise);
+}
+
+/*whole lines go above the cursor row, the other lines are spliced at the cursor. 
+All the rows are inserted with a single move of the rows below them*/
+void editorPaste() {
+    editorClipMaterialize();
+    struct editorClipboard *c = &E.clip;
+    int n = c->numlines;
+    if (n == 0) {
+        editorSetStatusMessage("Nothing to paste");
+        return;
+    }
+    E.mark = MARK_OFF;
+    if (c->linewise) {
+        editorInsertRows(E.cy, c->lines, n, c->base);
+        E.cx = 0;
+        return;
+    }
+
+    if (E.cy == E.numrows)
+        editorInsertRow(E.numrows, "", 0);
+    erow *row = &E.row[E.cy];
+    //the text after the cursor ends up after the last line pasted
+    int tail = row->size - E.cx;
+    int headlen = E.cx + c->lines[0].size + (n == 1 ? tail : 0);
+    char *head = malloc(headlen + 1);
+    memcpy(head, row->chars, E.cx);
+    memcpy(&head[E.cx], c->lines[0].chars, c->lines[0].size);
+    if (n == 1)
+        memcpy(&head[E.cx + c->lines[0].size], &row->chars[E.cx], tail);
+    char *rest = malloc(tail + 1);
+    memcpy(rest, &row->chars[E.cx], tail);
+
+    if (n > 1) {
+        editorInsertRows(E.cy + 1, &c->lines[1], n - 1, c->base);
+        editorRowAppendString(&E.row[E.cy + n - 1], rest, tail);
+    }
+    editorRowSetString(&E.row[E.cy], head, headlen);
+    free(head);
+    free(rest);
+    if (n == 1) {
+        E.cx += c->lines[0].size;
+    } else {
+        E.cy += n - 1;
+        E.cx = c->lines[n - 1].size;
+    }
+}
+
+//DIFF//
+//the working space of editorDiffRange()
+struct diffCtx {
+    uint64_t *a, *b; //hashes of the lines of the file and of the rows
+    unsigned char *del, *add; //lines deleted from a and added in b
+    int v1[2 * KILO_DIFF_MAX_D + 2];
+    int v2[2 * KILO_DIFF_MAX_D + 2];
+};
+
+//FNV-1a, rows with the same hash are taken as equal
+uint64_t editorDiffHash(const char *s, int len) {
+    uint64_t h = 14695981039346656037ULL;
+    int j;
+    for (j = 0; j < len; j++) {
+        h ^= (unsigned char)s[j];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+//1 if line i of the file is row j of the buffer
+int editorDiffSame(struct editorBase *disk, int i, int j) {
+    erow *row = &E.row[j];
+    char *line = &disk->data[disk->lineoff[i]];
+    if (row->size != disk->linelen[i])
+        return 0;
+    //rows still borrowed from the same storage don't even have to be compared
+    return row->chars == line || memcmp(row->chars, line, row->size) == 0;
+}
+
+/*finds where to split a[a0,a1) and b[b0,b1) in two smaller diffs, with the 
+forward and backward searches of Myers meeting in the middle, in linear space. 
+Returns -1 if they don't meet in KILO_DIFF_MAX_D steps*/
+int editorDiffBisect(struct diffCtx *c, int a0, int a1, int b0, int b1, int *sx, int *sy) {
+    uint64_t *a = &c->a[a0];
+    uint64_t *b = &c->b[b0];
+    int n = a1 - a0, m = b1 - b0;
+    int maxd = (n + m + 1) / 2;
+    if (maxd > KILO_DIFF_MAX_D)
+        maxd = KILO_DIFF_MAX_D;
+    int off = maxd;
+    int vlen = 2 * maxd + 2;
+    int *v1 = c->v1, *v2 = c->v2;
+    int j;
+    for (j = 0; j < vlen; j++)
+        v1[j] = v2[j] = -1;
+    v1[off + 1] = 0;
+    v2[off + 1] = 0;
+    int delta = n - m;
+    //with an odd delta the forward search is the one that reaches the other
+    int front = (delta & 1);
+    //diagonals that went off the grid are not looked at again
+    int k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+    int d, k1, k2;
+    for (d = 0; d < maxd; d++) {
+        for (k1 = -d + k1start; k1 <= d - k1end; k1 += 2) {
+            int k1off = off + k1;
+            int x1;
+            if (k1 == -d || (k1 != d && v1[k1off - 1] < v1[k1off + 1]))
+                x1 = v1[k1off + 1];
+            else
+                x1 = v1[k1off - 1] + 1;
+            int y1 = x1 - k1;
+            while (x1 < n && y1 < m && a[x1] == b[y1]) {
+                x1++;
+                y1++;
+            }
+            v1[k1off] = x1;
+            if (x1 > n) {
+                k1end += 2;
+            } else if (y1 > m) {
+                k1start += 2;
+            } else if (front) {
+                int k2off = off + delta - k1;
+                if (k2off >= 0 && k2off < vlen && v2[k2off] != -1 && x1 >= n - v2[k2off]) {
+                    *sx = x1;
+                    *sy = y1;
+                    return 0;
+                }
+            }
+        }
+        for (k2 = -d + k2start; k2 <= d - k2end; k2 += 2) {
+            int k2off = off + k2;
+            int x2;
+            if (k2 == -d || (k2 != d && v2[k2off - 1] < v2[k2off + 1]))
+                x2 = v2[k2off + 1];
+            else
+                x2 = v2[k2off - 1] + 1;
+            int y2 = x2 - k2;
+            while (x2 < n && y2 < m && a[n - x2 - 1] == b[m - y2 - 1]) {
+                x2++;
+                y2++;
+            }
+            v2[k2off] = x2;
+            if (x2 > n) {
+                k2end += 2;
+            } else if (y2 > m) {
+                k2start += 2;
+            } else if (!front) {
+                int k1off = off + delta - k2;
+                if (k1off >= 0 && k1off < vlen && v1[k1off] != -1) {
+                    int x1 = v1[k1off];
+                    if (x1 >= n - x2) {
+                        *sx = x1;
+                        *sy = off + x1 - k1off;
+                        return 0;
+                    }
+                }
+            }
+        }
+    }
+    return -1;
+}
+
+//marks the lines deleted from a[a0,a1) and added in b[b0,b1)
+void editorDiffRange(struct diffCtx *c, int a0, int a1, int b0, int b1) {
+    while (a0 < a1 && b0 < b1 && c->a[a0] == c->b[b0]) {
+        a0++;
+        b0++;
+    }
+    while (a0 < a1 && b0 < b1 && c->a[a1 - 1] == c->b[b1 - 1]) {
+        a1--;
+        b1--;
+    }
+    int x, y;
+    if (a0 == a1 || b0 == b1 || editorDiffBisect(c, a0, a1, b0, b1, &x, &y) == -1) {
+        memset(&c->del[a0], 1, a1 - a0);
+        memset(&c->add[b0], 1, b1 - b0);
+        return;
+    }
+    editorDiffRange(c, a0, a0 + x, b0, b0 + y);
+    editorDiffRange(c, a0 + x, a1, b0 + y, b1);
+}
+
+/*diffs the rows against d->disk. The common lines at both ends are skipped 
+first (the rows still borrowed from the file are skipped without looking at 
+them), so a small edit of a huge file only diffs the few rows around it*/
+void editorDiffCompute(struct editorDiff *d) {
+    struct editorBase *disk = d->disk;
+    int n = disk->numlines, m = E.numrows;
+    int p = 0;
+    if (disk == E.base)
+        p = E.pristine_rows;
+    if (p > n)
+        p = n;
+    if (p > m)
+        p = m;
+    while (p < n && p < m && editorDiffSame(disk, p, p))
+        p++;
+    int s = 0;
+    while (s < n - p && s < m - p && editorDiffSame(disk, n - 1 - s, m - 1 - s))
+        s++;
+
+    //only the middle is diffed, indexes in c are relative to p
+    int na = n - p - s, nb = m - p - s;
+    struct diffCtx *c = malloc(sizeof(struct diffCtx));
+    c->a = malloc(sizeof(uint64_t) * (na + 1));
+    c->b = malloc(sizeof(uint64_t) * (nb + 1));
+    c->del = calloc(na + 1, 1);
+    c->add = calloc(nb + 1, 1);
+    int j;
+    for (j = 0; j < na; j++)
+        c->a[j] = editorDiffHash(&disk->data[disk->lineoff[p + j]], disk->linelen[p + j]);
+    for (j = 0; j < nb; j++)
+        c->b[j] = editorDiffHash(E.row[p + j].chars, E.row[p + j].size);
+    editorDiffRange(c, 0, na, 0, nb);
+
+    //consecutive deleted and added lines become one hunk
+    free(d->hunks);
+    d->hunks = NULL;
+    d->numhunks = 0;
+    int i = 0;
+    j = 0;
+    while (i < na || j < nb) {
+        if ((i < na && c->del[i]) || (j < nb && c->add[j])) {
+            struct diffHunk h = { p + i, 0, p + j, 0 };
+            while ((i < na && c->del[i]) || (j < nb && c->add[j])) {
+                if (i < na && c->del[i]) {
+                    i++;
+                    h.dellen++;
+                } else {
+                    j++;
+                    h.addlen++;
+                }
+            }
+            d->hunks = realloc(d->hunks, sizeof(struct diffHunk) * (d->numhunks + 1));
+            d->hunks[d->numhunks++] = h;
+        } else {
+            i++;
+            j++;
+        }
+    }
+    free(c->a);
+    free(c->b);
+    free(c->del);
+    free(c->add);
+    free(c);
+    d->dirty = E.dirty;
+    d->numrows = E.numrows;
+}
+
+//the last hunk starting at or before row r, or -1
+int editorDiffHunkAt(int r) {
+    struct editorDiff *d = E.diff;
+    int lo = 0, hi = d->numhunks - 1, found = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (d->hunks[mid].b <= r) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+//lines of the file deleted right before row r, they are shown above it
+int editorDiffDeletedAt(int r) {
+    int h = editorDiffHunkAt(r);
+    return (h >= 0 && E.diff->hunks[h].b == r) ? E.diff->hunks[h].dellen : 0;
+}
+
+//the screen row of the cursor, counting the deleted lines shown between the rows
+int editorDiffScreenY() {
+    int y = 0;
+    int r;
+    for (r = E.rowoff; r < E.cy && y < E.screenrows; r++)
+        y += 1 + editorDiffDeletedAt(r);
+    return y + editorDiffDeletedAt(E.cy);
+}
+
+void editorDiffClose() {
+    if (E.diff == NULL)
+        return;
+    editorBaseRelease(E.diff->disk);
+    free(E.diff->hunks);
+    free(E.diff);
+    E.diff = NULL;
+}
+
+//Ctrl-D shows (or hides) what changed compared to the file on disk
+void editorDiffToggle() {
+    if (E.diff) {
+        editorDiffClose();
+        editorSetStatusMessage("");
+        return;
+    }
+    if (E.filename == NULL || E.compression != COMP_NONE || E.view_start > 0) {
+        editorSetStatusMessage("Only files that are not compressed can be diffed");
+        return;
+    }
+    struct editorBase *disk = editorBaseAcquire(E.filename);
+    if (disk == NULL) {
+        editorSetStatusMessage("Can't diff! I/O error: %s", strerror(errno));
+        return;
+    }
+    E.diff = calloc(1, sizeof(struct editorDiff));
+    E.diff->disk = disk;
+    editorDiffCompute(E.diff);
+    int added = 0, deleted = 0, j;
+    for (j = 0; j < E.diff->numhunks; j++) {
+        added += E.diff->hunks[j].addlen;
+        deleted += E.diff->hunks[j].dellen;
+    }
+    E.mark = MARK_OFF;
+    editorSetStatusMessage("%d changes, +%d -%d lines (n/N = next/previous, Ctrl-D = close)",
+        E.diff->numhunks, added, deleted);
+}
+
+//moves to the next (or previous) hunk
+void editorDiffJump(int direction) {
+    struct editorDiff *d = E.diff;
+    int h = editorDiffHunkAt(E.cy);
+    if (direction == 1)
+        h++;
+    else if (h >= 0 && d->hunks[h].b == E.cy)
+        h--;
+    if (h < 0 || h >= d->numhunks) {
+        editorSetStatusMessage("No more changes");
+        return;
+    }
+    E.cy = d->hunks[h].b;
+    E.cx = 0;
+}
+
+/*the diff view is read only: n and N move between the changes and editing 
+keys are refused. Returns 1 if it took care of key*/
+int editorDiffKey(int key) {
+    switch (key) {
+        case 'n':
+            editorDiffJump(1);
+            return 1;
+        case 'N':
+            editorDiffJump(-1);
+            return 1;
+        case '\x1b':
+        case CTRL_KEY('d'):
+            editorDiffToggle();
+            return 1;
+        case '\r':
+        case '\t':
+        case BACKSPACE:
+        case DEL_KEY:
+        case CTRL_KEY('h'):
+        case CTRL_KEY('x'):
+        case CTRL_KEY('v'):
+            editorSetStatusMessage("The diff view is read only (Ctrl-D to close it)");
+            return 1;
+    }
+    if (key < 1000 && !iscntrl(key)) {
+        editorSetStatusMessage("The diff view is read only (Ctrl-D to close it)");
+        return 1;
+    }
+    return 0;
+}
+
+//COLUMNS//
+/*splits s at the delimiter, except inside "quoted" fields ("" is a quote in 
+them) of comma separated files: tsv has no quoting, a " there (like in 12" 
+pipe) is just a character. (*offs)[i] is where field i starts and the entry after the last field 
+is len + 1, *offs is grown up to *cap as needed. Returns the number of fields. 
+It only reads s, so the search thread uses it too*/
+int editorParseFields(const char *s, int len, char delim, int **offs, int *cap) {
+    int n = 0;
+    int quoted = 0;
+    int quotes = (delim == ',');
+    int j;
+    if (*cap < 2) {
+        *cap = 16;
+        *offs = realloc(*offs, sizeof(int) * *cap);
+    }
+    (*offs)[n++] = 0;
+    for (j = 0; j < len; j++) {
+        if (s[j] == '"' && quotes) {
+            quoted = !quoted; //"" inside a quoted field toggles twice
+        } else if (s[j] == delim && !quoted) {
+            if (n + 1 >= *cap) {
+                *cap *= 2;
+                *offs = realloc(*offs, sizeof(int) * *cap);
+            }
+            (*offs)[n++] = j + 1;
+        }
+    }
+    (*offs)[n] = len + 1;
+    return n;
+}
+
+//the fields of a row, only parsed once it is needed (drawn, or the cursor is on it)
+int *editorRowFields(erow *row) {
+    if (row->fields == NULL) {
+        int cap = 0;
+        row->numfields = editorParseFields(row->chars, row->size, E.cols->delimiter, &row->fields, &cap);
+    }
+    return row->fields;
+}
+
+//the text shown for the field between from and to, without its quotes (if it is csv)
+void editorFieldText(const char *s, char delim, int from, int to, int *start, int *len) {
+    if (delim == ',' && to - from >= 2 && s[from] == '"' && s[to - 1] == '"') {
+        from++;
+        to--;
+    }
+    *start = from;
+    *len = to - from;
+}
+
+/*widens the columns to fit the rows from from on: the first KILO_COL_SAMPLE of 
+them and as many spread over the rest, a longer row elsewhere is truncated when 
+drawn. The whole file is measured first, then only the rows appended after 
+that (by follow mode or while a compressed file is decoded)*/
+void editorColumnsMeasure(int from) {
+    struct editorColumns *c = E.cols;
+    int *offs = NULL;
+    int cap = 0;
+    int count = E.numrows - from;
+    int top = count < KILO_COL_SAMPLE ? count : KILO_COL_SAMPLE;
+    int rest = count - top;
+    int samples = top + (rest < KILO_COL_SAMPLE ? rest : KILO_COL_SAMPLE);
+    int k;
+    for (k = 0; k < samples; k++) {
+        int r = from + ((k < top) ? k : top + (int)((long long)rest * (k - top) / (samples - top)));
+        erow *row = &E.row[r];
+        int n = editorParseFields(row->chars, row->size, c->delimiter, &offs, &cap);
+        if (n > c->numcols) {
+            c->widths = realloc(c->widths, sizeof(int) * n);
+            while (c->numcols < n)
+                c->widths[c->numcols++] = 1;
+        }
+        int i;
+        for (i = 0; i < n; i++) {
+            int start, len;
+            editorFieldText(row->chars, c->delimiter, offs[i], offs[i + 1] - 1, &start, &len);
+            if (len > KILO_COL_MAX_WIDTH)
+                len = KILO_COL_MAX_WIDTH;
+            if (len > c->widths[i])
+                c->widths[i] = len;
+        }
+    }
+    free(offs);
+    c->measured = E.numrows;
+}
+
+//the width of column i, the columns no sampled row has get a default one
+int editorColumnWidth(int i) {
+    struct editorColumns *c = E.cols;
+    //rows at the end that were deleted and added again are measured again too
+    if (c->measured > E.numrows)
+        c->measured = E.numrows;
+    if (E.numrows > c->measured)
+        editorColumnsMeasure(c->measured);
+    return (i < c->numcols) ? c->widths[i] : 8;
+}
+
+//the field of the row the cursor is in
+int editorColumnAt(int cy, int cx) {
+    if (cy >= E.numrows)
+        return 0;
+    erow *row = &E.row[cy];
+    int *offs = editorRowFields(row);
+    int i = 0;
+    while (i + 1 < row->numfields && offs[i + 1] <= cx)
+        i++;
+    return i;
+}
+
+//where the cursor is drawn, in the field it is in (columns are 3 wider with their separator)
+int editorColumnsScreenX() {
+    struct editorColumns *c = E.cols;
+    int f = editorColumnAt(E.cy, E.cx);
+    int x = 0;
+    int i;
+    for (i = c->first; i < f; i++)
+        x += editorColumnWidth(i) + 3;
+    if (E.cy < E.numrows) {
+        erow *row = &E.row[E.cy];
+        int start, len;
+        editorFieldText(row->chars, E.cols->delimiter, row->fields[f], row->fields[f + 1] - 1, &start, &len);
+        int pos = E.cx - start;
+        if (pos < 0)
+            pos = 0;
+        if (pos >= editorColumnWidth(f))
+            pos = editorColumnWidth(f) - 1;
+        x += pos;
+    }
+    return x;
+}
+
+//scrolls by whole columns, so the one the cursor is in is shown from its start
+void editorColumnsScroll() {
+    struct editorColumns *c = E.cols;
+    int f = editorColumnAt(E.cy, E.cx);
+    if (f < c->first)
+        c->first = f;
+    while (c->first < f) {
+        int x = 0;
+        int i;
+        for (i = c->first; i <= f; i++)
+            x += editorColumnWidth(i) + 3;
+        if (x <= E.screencols)
+            break;
+        c->first++;
+    }
+    E.coloff = 0;
+    E.rx = editorColumnsScreenX();
+}
+
+void editorColumnsOn(char delimiter) {
+    E.cols = calloc(1, sizeof(struct editorColumns));
+    E.cols->delimiter = delimiter;
+}
+
+//csv and tsv files are shown in columns from the start, when they are opened to be seen
+void editorColumnsAuto() {
+    if (!E.headless && E.syntax && E.syntax->delimiter && E.cols == NULL)
+        editorColumnsOn(E.syntax->delimiter);
+}
+
+void editorColumnsOff() {
+    if (E.cols == NULL)
+        return;
+    int j;
+    for (j = 0; j < E.numrows; j++) {
+        free(E.row[j].fields);
+        E.row[j].fields = NULL;
+    }
+    free(E.cols->widths);
+    free(E.cols);
+    E.cols = NULL;
+}
+
+/*the delimiter is the one of the filetype, otherwise a tab if the first row 
+has one and a comma if not*/
+void editorColumnsToggle() {
+    if (E.cols) {
+        editorColumnsOff();
+        editorSetStatusMessage("Column mode off");
+        return;
+    }
+    char delimiter = ',';
+    if (E.syntax && E.syntax->delimiter)
+        delimiter = E.syntax->delimiter;
+    else if (E.numrows > 0 && memchr(E.row[0].chars, '\t', E.row[0].size))
+        delimiter = '\t';
+    editorColumnsOn(delimiter);
+    editorSetStatusMessage("Column mode on (%s separated, Ctrl-E to leave)", delimiter == '\t' ? "tab" : "comma");
+}
+
+//moves the cursor to column n (from 1) of its row
+void editorColumnsGoto(int n) {
+    if (E.cy >= E.numrows)
+        return;
+    erow *row = &E.row[E.cy];
+    int *offs = editorRowFields(row);
+    if (n < 1)
+        n = 1;
+    if (n > row->numfields)
+        n = row->numfields;
+    E.cx = offs[n - 1];
+}
+
+/*finds q in column of s, offs and cap are scratch space for the fields as in 
+editorParseFields(). Returns the offset of the match in s or -1*/
+int editorFieldFind(const char *s, int len, char delim, int column, const char *q, size_t qlen, int **offs, int *cap) {
+    int n = editorParseFields(s, len, delim, offs, cap);
+    if (column >= n)
+        return -1;
+    int from = (*offs)[column];
+    int to = (*offs)[column + 1] - 1;
+    char *match = memmem(s + from, to - from, q, qlen);
+    return match ? match - s : -1;
+}
+
+//FIND//
+//the search of editorFindCallBack(), kept between keypresses (and set by editorSearchPoll())
+static int find_last_match = -1;
+static int find_direction = 1;
+static int find_column = -1; //the column searched in column mode
+
+/*looks at the rows of a snapshot after start, like editorFindCallBack() does 
+with the live rows (both match chars, so a tab in the row only matches a tab)*/
+void *editorSearchThread(void *arg) {
+    struct editorSearchJob *job = arg;
+    struct editorSnapshot *snap = job->snap;
+    struct findFilter filter;
+    editorFindFilterInit(&filter, job->query, snap->base, snap->pristine_rows);
+    size_t qlen = strlen(job->query);
+    int *offs = NULL;
+    int cap = 0;
+    int hint = 0;
+    int current = job->start;
+    int i;
+    for (i = 0; i < job->count && !job->cancel; i++) {
+        current += job->direction;
+        if (current == -1)
+            current = snap->numrows - 1;
+        else if (current == snap->numrows)
+            current = 0;
+
+        int skip = editorFindSkip(&filter, current, job->direction);
+        if (skip) {
+            current += (skip - 1) * job->direction;
+            i += skip - 1;
+            continue;
+        }
+        struct snapRow *row = editorSnapRow(snap, current, &hint);
+        if (job->column >= 0) {
+            int col = editorFieldFind(row->chars, row->size, job->delimiter, job->column, job->query, qlen, &offs, &cap);
+            if (col != -1) {
+                job->match_row = current;
+                job->match_col = col;
+                break;
+            }
+            continue;
+        }
+        char *match = memmem(row->chars, row->size, job->query, qlen);
+        if (match) {
+            job->match_row = current;
+            job->match_col = match - row->chars;
+            break;
+        }
+    }
+    free(offs);
+    editorFindFilterFree(&filter);
+    job->done = 1;
+    return NULL;
+}
+
+void editorSearchFree(struct editorSearchJob *job) {
+    if (job->threaded)
+        pthread_join(job->thread, NULL);
+    free(job->query);
+    free(job);
+}
+
+//cancels the background search, if any
+void editorSearchStop() {
+    if (E.search == NULL)
+        return;
+    E.search->cancel = 1;
+    editorSearchFree(E.search);
+    E.search = NULL;
+}
+
+/*searches count rows after from on a snapshot in a thread, so typing the 
+query doesn't wait for the whole file to be searched*/
+void editorSearchStart(char *query, int from, int count, int direction) {
+    //the rows can't be edited while the query is typed, but followed files still grow
+    if (E.search_snap && (E.search_snap_dirty != E.dirty || E.search_snap->numrows != E.numrows)) {
+        editorSnapshotRelease(E.search_snap);
+        E.search_snap = NULL;
+    }
+    if (E.search_snap == NULL) {
+        E.search_snap = editorSnapshotTake();
+        E.search_snap_dirty = E.dirty;
+    }
+    struct editorSearchJob *job = calloc(1, sizeof(struct editorSearchJob));
+    job->snap = E.search_snap;
+    job->query = strdup(query);
+    job->start = from;
+    job->count = count;
+    job->direction = direction;
+    job->dirty = E.dirty;
+    job->column = find_column;
+    job->delimiter = E.cols ? E.cols->delimiter : 0;
+    job->match_row = -1;
+    E.search = job;
+    job->threaded = (pthread_create(&job->thread, NULL, editorSearchThread, job) == 0);
+    if (!job->threaded)
+        editorSearchThread(job);
+}
+
+//moves to the match of the background search once it ends, returns 1 if it did
+int editorSearchPoll() {
+    struct editorSearchJob *job = E.search;
+    if (job == NULL || !job->done)
+        return 0;
+    E.search = NULL;
+    if (job->threaded)
+        pthread_join(job->thread, NULL);
+    job->threaded = 0;
+    //the match is in the rows as they were when the search started
+    if (job->match_row != -1 && job->dirty == E.dirty && job->match_row < E.numrows) {
+        find_last_match = job->match_row;
+        E.cy = job->match_row;
+        E.cx = job->match_col;
+        E.rowoff = E.numrows;
+    }
+    editorSearchFree(job);
+    return 1;
+}
+
+void editorFindCallBack(char *query, int key) {
+    //a new keypress makes the search still running pointless
+    editorSearchStop();
+    //returns immediately Enter or Esc when one of them is presed
+    if (key == '\r'|| key == '\x1b') {
+        find_last_match = -1;
+        find_direction = 1;
+        if (E.search_snap) {
+            editorSnapshotRelease(E.search_snap);
+            E.search_snap = NULL;
+        }
+        return;
+    } else if (key == ARROW_RIGHT || key == ARROW_DOWN) {
+        find_direction = 1;
+    } else if (key == ARROW_LEFT || key == ARROW_UP) {
+        find_direction = -1;
+    } else {
+        find_last_match = -1;
+        find_direction = 1;
+    }
+
+    if (find_last_match == -1)
+        find_direction = 1;
+    int direction = find_direction;
+    
+    //current is the index of the current searched row 
+    int current = find_last_match;
+    int i;
+    int *offs = NULL;
+    int cap = 0;
+    size_t qlen = strlen(query);
+    struct findFilter filter;
+    editorFindFilterInit(&filter, query, E.base, E.pristine_rows);
+
+    //loop through all the rows of the file    
+    for (i = 0; i < E.numrows; i++) {
+        //the rows left are searched in the background
+        if (i >= KILO_FIND_SYNC_ROWS) {
+            editorSearchStart(query, current, E.numrows - i, direction);
+            break;
+        }
+        current += direction;
+        if (current == -1)
+            current = E.numrows -1;
+        else if (current == E.numrows)
+            current = 0;
+
+        //the rest of a block that can't have the query is skipped at once
+        int skip = editorFindSkip(&filter, current, direction);
+        if (skip) {
+            current += (skip - 1) * direction;
+            i += skip - 1;
+            continue;
+        }
+
+        // *row points to the currently analyzed row
+        erow *row = &E.row[current];
+        //in column mode the chars of the column are searched instead
+        if (find_column >= 0) {
+            int col = editorFieldFind(row->chars, row->size, E.cols->delimiter, find_column, query, qlen, &offs, &cap);
+            if (col != -1) {
+                find_last_match = current;
+                E.cy = current;
+                E.cx = col;
+                E.rowoff = E.numrows;
+                break;
+            }
+            continue;
+        }
+        /*finds the first occurrence of the substring (query) in row->chars, like 
+        the background search and the block filter do: a tab only matches a tab. 
+        memmem() returns a pointer to the first occurrence, or NULL*/
+        char *match = memmem(row->chars, row->size, query, qlen);
+        if (match) {
+            find_last_match = current;
+            // i checks the row, so the current row analysed is always i
+            E.cy = current;
+            //subtracts row->chars in order to know where in the row the match happens
+            E.cx = match - row->chars;
+            E.rowoff = E.numrows;
+            break;
+        }
+    }
+    free(offs);
+    editorFindFilterFree(&filter);
+}
+
+void editorFind() {
+    int saved_cx = E.cx;
+    int saved_cy = E.cy;
+    int saved_coloff = E.coloff;
+    int saved_rowoff = E.rowoff;
+    char prompt[64] = "Search %s (Use Esc/Arrows/Enter)";
+    find_column = -1;
+    if (E.cols && !E.diff) {
+        find_column = editorColumnAt(E.cy, E.cx);
+        snprintf(prompt, sizeof(prompt), "Search column %d: %%s (Use Esc/Arrows/Enter)", find_column + 1);
+    }
+    //query is a substring of the current row
+    char *query = editorPrompt(prompt, editorFindCallBack);
+    // query == NULL means Esc was
+    if (query == NULL) {
+        free(query);
+        } else {
+            E.cx = saved_cx;
+            E.cy = saved_cy;
+            E.coloff = saved_coloff;
+            E.rowoff = saved_rowoff; 
+        } 
+}
+
+//APPEND BUFFER//
+//pointer to the buffer memory and a length
+struct abuf {
+    char *b;
+    int len;
+};
+//ABUF_INIT is a constant that represents an empty buffer
+//acts as an constructor to abuf type
+#define ABUF_INIT {NULL, 0}
+
+void abAppend(struct abuf *ab, const char *s, int len) {
+    //realloc() to 0 bytes would free the buffer
+    if (len == 0)
+        return;
+    //realloc gives a block of memory resized
+    //new size = current size + size of the appended string
+    char *new = realloc(ab->b, ab->len + len);
+    
+    //to prevent to append nothing to the buffer
+    if (new == NULL)
+        return;
+    //copies the memory of the string s after the end of the current
+    //data in the buffer and updates the abuf's lenght
+    memcpy(&new[ab->len], s, len);
+    ab->b = new;
+    ab->len += len;
+}
+
+void abFree(struct abuf *ab) {
+    free(ab->b);
+}
+
+//OUTPUT//
+/*frames are written by a thread (see editorOutputThread()), so a slow terminal 
+never blocks the input. Only the newest frame waits to be written: every frame 
+redraws the whole screen, so an older one that was not started is dropped*/
+struct editorOutput {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t idle;
+    int started;
+    int busy;
+    struct abuf raw; //bytes that are not a frame, all of them are written
+    struct abuf frame;
+    struct timespec last_frame;
+};
+
+struct editorOutput output = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .idle = PTHREAD_COND_INITIALIZER,
+};
+
+void *editorOutputThread(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&output.lock);
+    while (1) {
+        while (output.raw.len == 0 && output.frame.len == 0) {
+            output.busy = 0;
+            pthread_cond_broadcast(&output.idle);
+            pthread_cond_wait(&output.wake, &output.lock);
+        }
+        //both buffers are taken, new output goes to fresh ones meanwhile
+        struct abuf raw = output.raw;
+        struct abuf frame = output.frame;
+        output.raw = (struct abuf)ABUF_INIT;
+        output.frame = (struct abuf)ABUF_INIT;
+        output.busy = 1;
+        pthread_mutex_unlock(&output.lock);
+
+        struct iovec iov[2];
+        int cnt = 0;
+        if (raw.len) {
+            iov[cnt].iov_base = raw.b;
+            iov[cnt].iov_len = raw.len;
+            cnt++;
+        }
+        if (frame.len) {
+            iov[cnt].iov_base = frame.b;
+            iov[cnt].iov_len = frame.len;
+            cnt++;
+        }
+        //there is nothing to do about a terminal that can't be written to
+        editorWritevAll(STDOUT_FILENO, iov, cnt);
+        abFree(&raw);
+        abFree(&frame);
+        pthread_mutex_lock(&output.lock);
+    }
+    return NULL;
+}
+
+//without the thread, everything is written right away
+void editorOutputStart() {
+    output.started = (pthread_create(&output.thread, NULL, editorOutputThread, NULL) == 0);
+    if (output.started)
+        pthread_detach(output.thread);
+}
+
+//output that is not a frame, like escape sequences for the terminal itself
+void editorOutputWrite(const char *s, int len) {
+    if (!output.started) {
+        write(STDOUT_FILENO, s, len);
+        return;
+    }
+    pthread_mutex_lock(&output.lock);
+    abAppend(&output.raw, s, len);
+    pthread_cond_signal(&output.wake);
+    pthread_mutex_unlock(&output.lock);
+}
+
+//takes ab, replacing the frame that is waiting to be written (if any)
+void editorOutputFrame(struct abuf *ab) {
+    clock_gettime(CLOCK_MONOTONIC, &output.last_frame);
+    if (!output.started) {
+        write(STDOUT_FILENO, ab->b, ab->len);
+        abFree(ab);
+        return;
+    }
+    pthread_mutex_lock(&output.lock);
+    abFree(&output.frame);
+    output.frame = *ab;
+    pthread_cond_signal(&output.wake);
+    pthread_mutex_unlock(&output.lock);
+}
+
+//waits until everything was written
+void editorOutputFlush() {
+    if (!output.started)
+        return;
+    pthread_mutex_lock(&output.lock);
+    while (output.busy || output.raw.len || output.frame.len)
+        pthread_cond_wait(&output.idle, &output.lock);
+    pthread_mutex_unlock(&output.lock);
+}
+
+//1 if it is time for a new frame even though more keys are waiting
+int editorFrameDue() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long ns = (now.tv_sec - output.last_frame.tv_sec) * 1000000000LL +
+        (now.tv_nsec - output.last_frame.tv_nsec);
+    return ns >= 1000000000LL / KILO_FPS;
+}
+
+void editorScroll() {
+    E.rx = 0;
+    //sets E.rx to its proper value
+    if (E.cy < E.numrows) {
+        E.rx = editorRowCxToRx(&E.row[E.cy], E.cx);
+    }
+    // E.rowoff is used to check if the cursor moved outside the visible window
+    //if it is outside, is adjusts
+    if (E.cy < E.rowoff) { //checks if the cursor is above the window
+        E.rowoff = E.cy;
+    }
+    if (E.cy >= E.rowoff + E.screenrows) { //checks if the cursor is under the window
+        E.rowoff = E.cy - E.screenrows + 1;
+    }
+    //the deleted lines of the diff view take screen rows too
+    while (E.diff && E.rowoff < E.cy && editorDiffScreenY() >= E.screenrows)
+        E.rowoff++;
+    if (E.cols && !E.diff) {
+        editorColumnsScroll();
+        return;
+    }
+    //the diff view uses the first column for its markers
+    int cols = E.diff ? E.screencols - 1 : E.screencols;
+    if (E.rx < E.coloff) { //checks if the cursor is left to the window
+        E.coloff = E.rx;
+    }
+    if (E.rx >= E.coloff + cols) { //checks if the cursor is right to the window
+        E.coloff = E.rx - cols + 1;
+    }
+}
+
+//draws a row of the buffer in at most cols columns, from E.coloff
+void editorDrawRow(struct abuf *ab, int filerow, int cols) {
+    int r1, c1, r2, c2;
+    int mode = editorSelection(&r1, &c1, &r2, &c2);
+    editorRenderRow(&E.row[filerow]);
+    int len = E.row[filerow].rsize - E.coloff;
+    if (len < 0) // happens when it is above the screen
+        len = 0; //returns to the leftmost column
+    if (len > cols)
+        len = cols;
+    editorHighlightRow(filerow);
+    char *c = &E.row[filerow].render[E.coloff];
+    unsigned char *hl = &E.row[filerow].hl[E.coloff];
+    //the selected columns of this row are shown inverted
+    int sel_from = 0, sel_to = 0;
+    if (mode != MARK_OFF && filerow >= r1 && filerow <= r2) {
+        erow *row = &E.row[filerow];
+        sel_from = (mode == MARK_CHARS && filerow == r1) ? editorRowCxToRx(row, c1) : 0;
+        sel_to = (mode == MARK_CHARS && filerow == r2) ? editorRowCxToRx(row, c2) : row->rsize;
+        sel_from -= E.coloff;
+        sel_to -= E.coloff;
+    }
+    int selected = 0;
+    //-1 is the default color, escape sequences are only written when the color changes
+    int current_color = -1;
+    int j = 0;
+    while (j < len) {
+        int sel = (j >= sel_from && j < sel_to);
+        if (sel != selected) {
+            if (sel)
+                abAppend(ab, "\x1b[7m", 4);
+            else
+                abAppend(ab, "\x1b[27m", 5);
+            selected = sel;
+        }
+        if (iscntrl((unsigned char)c[j])) {
+            //control characters are shown inverted as @, A, B... or ? 
+            char sym = (c[j] <= 26) ? '@' + c[j] : '?';
+            abAppend(ab, "\x1b[7m", 4);
+            abAppend(ab, &sym, 1);
+            abAppend(ab, "\x1b[m", 3);
+            //\x1b[m also resets the color, so it has to be set again
+            if (current_color != -1) {
+                char buf[16];
+                int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", current_color);
+                abAppend(ab, buf, clen);
+            }
+            if (selected)
+                abAppend(ab, "\x1b[7m", 4);
+            j++;
+            continue;
+        }
+        int color = (hl[j] == HL_NORMAL) ? -1 : editorSyntaxToColor(hl[j]);
+        if (color != current_color) {
+            char buf[16];
+            int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color == -1 ? 39 : color);
+            abAppend(ab, buf, clen);
+            current_color = color;
+        }
+        //appends the whole run of characters with the same highlight at once
+        int run = j + 1;
+        while (run < len && hl[run] == hl[j] && !iscntrl((unsigned char)c[run]) &&
+            (run >= sel_from && run < sel_to) == sel)
+            run++;
+        abAppend(ab, &c[j], run - j);
+        j = run;
+    }
+    if (selected)
+        abAppend(ab, "\x1b[27m", 5);
+    if (current_color != -1)
+        abAppend(ab, "\x1b[39m", 5);
+}
+
+/*draws a row in column mode, from the first column shown. Each field is padded 
+or cut to the width of its column and followed by a dim separator*/
+void editorDrawColumnsRow(struct abuf *ab, int filerow, int cols) {
+    int r1, c1, r2, c2;
+    int mode = editorSelection(&r1, &c1, &r2, &c2);
+    erow *row = &E.row[filerow];
+    int *offs = editorRowFields(row);
+    int sel_from = 0, sel_to = 0;
+    if (mode != MARK_OFF && filerow >= r1 && filerow <= r2) {
+        sel_from = (mode == MARK_CHARS && filerow == r1) ? c1 : 0;
+        sel_to = (mode == MARK_CHARS && filerow == r2) ? c2 : row->size;
+    }
+    int x = 0;
+    int i;
+    for (i = E.cols->first; i < row->numfields && x < cols; i++) {
+        int width = editorColumnWidth(i);
+        int start, len;
+        editorFieldText(row->chars, E.cols->delimiter, offs[i], offs[i + 1] - 1, &start, &len);
+        int j;
+        for (j = 0; j < width && x < cols; j++, x++) {
+            int p = start + j;
+            if (j >= len) {
+                abAppend(ab, " ", 1);
+                continue;
+            }
+            //a field cut to the width ends with a ">"
+            char ch = (j == width - 1 && len > width) ? '>' : row->chars[p];
+            if (iscntrl((unsigned char)ch))
+                ch = '?';
+            if (p >= sel_from && p < sel_to) {
+                abAppend(ab, "\x1b[7m", 4);
+                abAppend(ab, &ch, 1);
+                abAppend(ab, "\x1b[27m", 5);
+            } else {
+                abAppend(ab, &ch, 1);
+            }
+        }
+        if (i + 1 < row->numfields && x + 3 <= cols) {
+            abAppend(ab, " \x1b[2m|\x1b[22m ", 12);
+            x += 3;
+        }
+    }
+}
+
+//draws line i of the file on disk, which has no render of its own
+void editorDrawDiskLine(struct abuf *ab, struct editorBase *disk, int i, int cols) {
+    char *line = &disk->data[disk->lineoff[i]];
+    int len = disk->linelen[i];
+    int rx = 0;
+    int j;
+    for (j = 0; j < len && rx < E.coloff + cols; j++) {
+        char ch = line[j];
+        int width = 1;
+        if (ch == '\t') {
+            width = KILO_TAB_STOP - (rx % KILO_TAB_STOP);
+            ch = ' ';
+        } else if (iscntrl((unsigned char)ch)) {
+            ch = '?';
+        }
+        while (width-- > 0 && rx < E.coloff + cols) {
+            if (rx >= E.coloff)
+                abAppend(ab, &ch, 1);
+            rx++;
+        }
+    }
+}
+
+//the rows with a "+" before the added ones, and the deleted lines with a "-" where they were
+void editorDrawDiff(struct abuf *ab) {
+    struct editorDiff *d = E.diff;
+    int r = E.rowoff;
+    int del = 0; //deleted lines already drawn above row r
+    int y;
+    for (y = 0; y < E.screenrows; y++) {
+        int h = editorDiffHunkAt(r);
+        struct diffHunk *hunk = (h >= 0) ? &d->hunks[h] : NULL;
+        if (hunk && hunk->b == r && del < hunk->dellen) {
+            abAppend(ab, "\x1b[31m-", 6);
+            editorDrawDiskLine(ab, d->disk, hunk->a + del, E.screencols - 1);
+            abAppend(ab, "\x1b[39m", 5);
+            del++;
+        } else if (r < E.numrows) {
+            if (hunk && r < hunk->b + hunk->addlen)
+                abAppend(ab, "\x1b[32m+\x1b[39m", 11);
+            else
+                abAppend(ab, " ", 1);
+            editorDrawRow(ab, r, E.screencols - 1);
+            r++;
+            del = 0;
+        } else {
+            abAppend(ab, "~", 1);
+        }
+        abAppend(ab, "\x1b[K", 3);
+        abAppend(ab, "\r\n", 2);
+    }
+}
+
+//draws the selected symbol ("~" for now) in all columns read and stored in the E.screencols
+void editorDrawRows(struct abuf *ab) {
+    if (E.diff) {
+        editorDrawDiff(ab);
+        return;
+    }
+    int y;
+    for (y = 0; y < E.screenrows; y++) {
+        //filerow gets the number row of the file and uses it as index of E.row
+        int filerow = y + E.rowoff;
+        //if the current drawing row is part of the text buffer
+        if (filerow >= E.numrows) {
+            if (E.numrows == 0 && y == E.screenrows / 3) {
+                //welcome is a buffer to interpolate KILO_VERSION into the welcomimng page
+                char welcome[80];
+                int welcomelen = snprintf(welcome, sizeof(welcome),
+                    "yeah %s", KILO_VERSION);
+                //if the size of the buffer is too big, it adjusts to the screen size
+                if (welcomelen > E.screencols) 
+                    welcomelen = E.screencols;
+                //finds the middle of the screen
+                int padding = (E.screencols - welcomelen) / 2;
+                // if (padding) is the same as if (padding != 0)
+                if (padding) {
+                    abAppend(ab, "~", 1);
+                    padding--;
+                } 
+                // while (padding-1 != 0)
+                while (padding--) 
+                    abAppend(ab, " ", 1);
+                abAppend(ab, welcome, welcomelen);
+            } else {
+                abAppend(ab, "~", 1);
+            }
+        } else if (E.cols) {
+            editorDrawColumnsRow(ab, filerow, E.screencols);
+        } else {
+            editorDrawRow(ab, filerow, E.screencols);
+        }
+        //cleans each line afte it is redrawn
+        // K erases in line (K2 erases the whole line)
+        abAppend(ab, "\x1b[K", 3);
+        //prints a newline after the last row it draws, 
+        //since the status bar is the final line being drawn on the screen
+        abAppend(ab, "\r\n", 2);
+    }
+}
+
+void editorDrawStatusBar(struct abuf *ab) {
+    //7m inverts the colors
+    abAppend(ab, "\x1b[7m", 4);
+    char status[80], rstatus[80];
+    //if E.filename != 0, then E.filename = E.filename, else, E.filename = "[No Name]"
+    //if E.dirty != 0, then "(modified)", else, ""
+    int len = 0;
+    //the buffer number is only shown when there is more than one
+    if (E.numbuffers > 1)
+        len = snprintf(status, sizeof(status), "[%d/%d] ", E.curbuf + 1, E.numbuffers);
+    len += snprintf(&status[len], sizeof(status) - len, "%.20s - %d lines %s%s", E.filename ? E.filename : "[No Name]", E.numrows, E.dirty ? "(modified)" : "", E.decoder ? "(loading)" : "");
+    //sums 1 to E.cy is zero indexed 
+    int rlen = snprintf(rstatus, sizeof(rstatus), "%s | %d/%d", E.syntax ? E.syntax->filetype : "no ft", E.cy + 1, E.numrows);
+    if(len > E.screencols)
+        len = E.screencols; 
+    abAppend(ab, status, len);
+    while (len < E.screencols) {
+        if (E.screencols - len == rlen) {
+            abAppend(ab, rstatus, rlen);
+            break;
+        } else {
+            abAppend(ab, " ", 1);
+            len++;   
+        }
+    }
+    //the m command in causes the text printed after it to be 
+    //printed with various possible attributes including: 
+    //bold (1), underscore (4), blink (5), and inverted colors (7) 
+    abAppend(ab, "\x1b[m", 3);
+    abAppend(ab, "\r\n", 2);
+}
+
+void editorDrawMessageBar(struct abuf *ab){
+    //clears message bar
+    abAppend(ab, "\x1b[K", 3);
+    int msglen = strlen(E.statusmsg);
+    if (msglen > E.screencols) 
+        msglen = E.screencols;
+    if (msglen && time(NULL) - E.statusmsg_time < 5)
+        abAppend(ab, E.statusmsg, msglen);
+}
+
+void editorRefreshScreen() {
+    //the diff view follows the rows appended by follow mode too
+    if (E.diff && (E.diff->dirty != E.dirty || E.diff->numrows != E.numrows))
+        editorDiffCompute(E.diff);
+    editorScroll();
+
+    struct abuf ab = ABUF_INIT;
+    // \x1b means 27 in hexa, whitch corresponds to Esc in the Ascii table
+    // Esc sequences are used to instruct terminal to formatting tasks
+    // [ is used as delimitator, what goes after is processed
+    // l command turns off terminal features
+    // ?25 is a doesnt document argument. so ?25l turns off the cursor
+    abAppend(&ab, "\x1b[?25l", 6); 
+    // H corresponds to cursor position
+    // H command recieves 2 arguments, the vertical and horizontal positions
+    // in a 20x10 terminal, move the cursor to center would be: \x1b[5;10H
+    // ergo, \x1b[H is \x1b[0;0H which corresponds to put the cursor in the top left corner
+    abAppend(&ab, "\x1b[H", 3);
+    //after mapping the terminal, all the lines are drawn the selected symbol 
+    editorDrawRows(&ab);
+    editorDrawStatusBar(&ab);
+    editorDrawMessageBar(&ab);
+    //moves the cursor to the origin (terminal uses 1-indexed values)
+    char buf[32];
+    int cursor_y = E.diff ? editorDiffScreenY() : E.cy - E.rowoff;
+    if (cursor_y >= E.screenrows)
+        cursor_y = E.screenrows - 1;
+    snprintf(buf, sizeof(buf), "\x1b[%d;%dH", cursor_y + 1, (E.rx - E.coloff) + 1 + (E.diff ? 1 : 0));
+    abAppend(&ab, buf, strlen(buf));
+    //?25H turns the cursor back up
+    abAppend(&ab, "\x1b[?25h", 6);
+    //the writer thread writes everything that was previously appended to the buffer, and frees it
+    editorOutputFrame(&ab);
+    // the \x1b[?25l and \x1b[?25H might not be supported, then they will be ignored 
+}
+
+/*"The three dots '...' are called an ellipsis. Using them in a function makes that 
+function a variadic function. To use them in a function declaration means that the 
+function will accept an arbitrary number of parameters after the ones already defined"*/
+void editorSetStatusMessage(const char *fmt, ...) {
+    va_list ap;
+    //initialises va_list
+    va_start(ap, fmt); //fmt is a reference to the function's last parameter
+    vsnprintf(E.statusmsg, sizeof(E.statusmsg), fmt, ap);
+    va_end(ap); //cleans up
+    E.statusmsg_time = time(NULL);
+}
+
+/*the key bindings don't fit in the status bar (E.statusmsg) at once, so the 
+help shows a page of them and Ctrl-L turns to the next one*/
+static const char *help_pages[] = {
+    "HELP: ^S save ^Q quit ^F find ^G goto ^T follow ^E columns ^D diff ^L more",
+    "HELP: ^B mark ^C/X/V copy/cut/paste ^O/N/P/W open/next/prev/close buf ^L back",
+};
+static int help_page = 0;
+
+void editorHelp() {
+    editorSetStatusMessage("%s", help_pages[help_page]);
+    help_page = (help_page + 1) % (int)(sizeof(help_pages) / sizeof(help_pages[0]));
+}
+
+//INPUT//
+char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
+    size_t bufsize = 128;
+    //buf is where the string is dinamically alocated
+    char *buf = malloc(bufsize);
+
+    size_t buflen = 0;
+    buf[0] = '\0';
+
+    while (1) {
+        editorSetStatusMessage(prompt, buf);
+        editorRefreshScreen();
+
+        int c = editorReadKey();
+        if (c == DEL_KEY || c == CTRL_KEY('h') || c == BACKSPACE) {
+            if (buflen != 0) buf[--buflen] = '\0';
+        //if Esc (\x1b) is pressed 
+        } else if (c == '\x1b') {
+            editorSetStatusMessage("");
+            //frees the buf's memory
+            free(buf); 
+            /*the three if (callbackbuf, c) allow the caller to pass NULL 
+            for the callback if it is not needed*/
+            if (callback)
+                callback(buf, c);
+            return NULL;
+        } else if (c == '\r') {
+            if (buflen !=0) {
+                editorSetStatusMessage("");
+                if (callback)
+                    callback(buf, c);
+                return buf;
+            }
+        } else if (!iscntrl(c) && c < 128) {
+            //if buflen reached maximum capacity
+            if (buflen == bufsize - 1) {
+                //double the capacity
+                bufsize *= 2;
+                //reallocate the buffer to bufsize
+                buf = realloc(buf, bufsize);
+            }
+            buf[buflen++] = c;
+            /*buf always ends with '\0', because 
+            editorSetStatusMessage() and editorPrompt() will use it to know where the string ends */
+            buf[buflen] = '\0';
+        }
+
+        if (callback)
+            callback(buf, c);
+    }
+}
+
+//work done while waiting for a keypress, returns 1 if the screen has to be redrawn
+int editorIdle() {
+    int changed = editorFollowPoll();
+    changed |= editorDecodePoll();
+    changed |= editorSavePoll(0);
+    changed |= editorSearchPoll();
+    //buffers that are not shown keep following (and decompressing and saving) their files too
+    int j;
+    for (j = 0; j < E.numbuffers; j++) {
+        if (j == E.curbuf || (!E.buffers[j].follow && !E.buffers[j].decoder && !E.buffers[j].saving))
+            continue;
+        editorBufferStash(&E.buffers[E.curbuf]);
+        editorBufferLoad(&E.buffers[j]);
+        editorFollowPoll();
+        editorDecodePoll();
+        editorSavePoll(0);
+        editorBufferStash(&E.buffers[j]);
+        editorBufferLoad(&E.buffers[E.curbuf]);
+    }
+    return changed;
+}
+
+void editorMoveCursor(int key) {
+    // if (E.cy >= E.numrows) -> NULL, else: &E.row[E.cy]
+    erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+
+    switch (key) {
+        case ARROW_LEFT:
+            if (E.cx != 0) {
+                E.cx--;
+            } else if (E.cy > 0) { // if you go left past the line
+                E.cy--;  // go one row up
+                E.cx = E.row[E.cy].size; // go to the last column
+            }
+            break;
+        case ARROW_RIGHT:
+            if (row && E.cx < row -> size) {
+                E.cx++;
+            } else if (row && E.cx == row -> size) { // if the cursor is at the end of the cursor
+                E.cy++; //move to the next line
+                E.cx = 0; //at the start of the line
+            }
+            break;
+        case ARROW_UP:
+            if (E.cy != 0) {
+                E.cy--;
+            }
+            break;
+        case ARROW_DOWN:
+            if (E.cy < E.numrows) {
+                E.cy++;
+            }
+            break;
+    }
+
+    row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+    int rowlen = row ? row -> size : 0;
+    if (E.cx > rowlen) {
+        E.cx = rowlen;
+    }
+}
+
+//moves the cursor delta rows up (negative) or down at once
+void editorMoveRows(int delta) {
+    long y = (long)E.cy + delta;
+    if (y < 0)
+        y = 0;
+    if (y > E.numrows)
+        y = E.numrows;
+    E.cy = y;
+    int rowlen = (E.cy < E.numrows) ? E.row[E.cy].size : 0;
+    if (E.cx > rowlen)
+        E.cx = rowlen;
+}
+
+//to the start of the next (or of the previous) word, across rows
+void editorMoveWord(int direction) {
+    if (E.numrows == 0)
+        return;
+    if (E.cy >= E.numrows) {
+        if (direction == 1)
+            return;
+        E.cy = E.numrows - 1;
+        E.cx = E.row[E.cy].size;
+    }
+    erow *row = &E.row[E.cy];
+    if (direction == 1) {
+        //the rest of the word under the cursor, then everything before the next word
+        while (E.cx < row->size && !is_separator(row->chars[E.cx]))
+            E.cx++;
+        while (1) {
+            while (E.cx < row->size && is_separator(row->chars[E.cx]))
+                E.cx++;
+            if (E.cx < row->size || E.cy == E.numrows - 1)
+                break;
+            E.cy++;
+            E.cx = 0;
+            row = &E.row[E.cy];
+        }
+    } else {
+        while (1) {
+            while (E.cx > 0 && is_separator(row->chars[E.cx - 1]))
+                E.cx--;
+            if (E.cx > 0 || E.cy == 0)
+                break;
+            E.cy--;
+            row = &E.row[E.cy];
+            E.cx = row->size;
+        }
+        while (E.cx > 0 && !is_separator(row->chars[E.cx - 1]))
+            E.cx--;
+    }
+}
+
+int editorRowBlank(erow *row) {
+    int j;
+    for (j = 0; j < row->size; j++) {
+        if (!isspace((unsigned char)row->chars[j]))
+            return 0;
+    }
+    return 1;
+}
+
+//to the blank row after the next paragraph (or before the previous one)
+void editorMoveParagraph(int direction) {
+    int y = E.cy;
+    if (y == E.numrows && direction == -1)
+        y--;
+    while (y >= 0 && y < E.numrows && editorRowBlank(&E.row[y]))
+        y += direction;
+    while (y >= 0 && y < E.numrows && !editorRowBlank(&E.row[y]))
+        y += direction;
+    if (y < 0)
+        y = 0;
+    if (y > E.numrows)
+        y = E.numrows;
+    E.cy = y;
+    E.cx = 0;
+}
+
+/*Ctrl-G goes to a line, or to a percentage of the file. A seekable compressed 
+file is not all loaded, so the percentage is of the file and it is jumped into*/
+void editorGotoPrompt() {
+    char *where = editorPrompt(E.cols ? "Go to line, N%% or cN (column): %s (Esc to cancel)" :
+        "Go to line or N%%: %s (Esc to cancel)", NULL);
+    if (where == NULL)
+        return;
+    if (E.cols && (where[0] == 'c' || where[0] == 'C')) {
+        editorColumnsGoto(atoi(&where[1]));
+        free(where);
+        return;
+    }
+    int n = atoi(where);
+    if (strchr(where, '%')) {
+        if (E.frames) {
+            editorDecodeJump(n);
+        } else {
+            if (n < 0)
+                n = 0;
+            if (n > 100)
+                n = 100;
+            editorMoveRows((int)((long long)E.numrows * n / 100) - E.cy);
+        }
+    } else {
+        editorMoveRows(n - 1 - E.cy);
+    }
+    if (E.cy == E.numrows && E.numrows > 0)
+        E.cy--;
+    E.cx = 0;
+    free(where);
+}
+
+/*how many times c was pressed, counting the same keys that are already 
+waiting (auto-repeat), so a run of them is one move and one redraw*/
+int editorKeyRepeats(int c) {
+    int times = 1;
+    while (editorKeyPending()) {
+        int next = editorReadKey();
+        if (next != c) {
+            editorUnreadKey(next);
+            break;
+        }
+        times++;
+    }
+    return times;
+}
+
+//waits for a keypress and handles it
+void editorProcessKeypress() {
+    static int quit_times = KILO_QUIT_TIMES;
+
+    int c = editorReadKey();
+    if (E.diff && editorDiffKey(c)) {
+        quit_times = KILO_QUIT_TIMES;
+        return;
+    }
+    //this switch has the keypress cases in it
+    switch (c) {
+        case '\r':
+            editorinsertNewline();
+            break;
+
+        case CTRL_KEY('q'):
+            //a save that is still running can't be left half done
+            editorSaveWaitAll();
+            if (editorAnyDirty() && quit_times > 0) {
+                editorSetStatusMessage("WARNING!!! File has unsaved changes. Press Ctrl-Q %d more times to quit.", quit_times);
+                quit_times--;
+                return;
+            }
+            //the frames still being written would come after the clearing
+            editorOutputFlush();
+            write(STDOUT_FILENO, "\x1b[2J", 4);
+            write(STDOUT_FILENO, "\x1b[H", 3);
+            exit(0);
+            break;
+
+        case CTRL_KEY('s'):
+            editorSave();
+            break;
+
+        case HOME_KEY:
+            E.cx = 0;
+            break;
+
+        // If there is no current line, then E.cx must be 0 and it should stay at 0, so there’s nothing to do
+        case END_KEY:
+            if (E.cy < E.numrows)
+                E.cx = E.row[E.cy].size;
+            break;
+        
+        case CTRL_KEY('f'):
+            editorFind();
+            break;
+
+        case CTRL_KEY('o'):
+            editorOpenBuffer();
+            break;
+
+        case CTRL_KEY('n'):
+            editorSwitchBuffer((E.curbuf + 1) % E.numbuffers);
+            break;
+
+        case CTRL_KEY('p'):
+            editorSwitchBuffer((E.curbuf + E.numbuffers - 1) % E.numbuffers);
+            break;
+
+        case CTRL_KEY('w'):
+            editorSavePoll(1);
+            if (E.dirty && quit_times > 0) {
+                editorSetStatusMessage("WARNING!!! Buffer has unsaved changes. Press Ctrl-W %d more times to close it.", quit_times);
+                quit_times--;
+                return;
+            }
+            editorCloseBuffer();
+            break;
+
+        case CTRL_KEY('g'):
+            editorGotoPrompt();
+            break;
+
+        case CTRL_KEY('b'):
+            editorMarkCycle();
+            break;
+
+        case CTRL_KEY('d'):
+            editorDiffToggle();
+            break;
+
+        case CTRL_KEY('e'):
+            editorColumnsToggle();
+            break;
+
+        case CTRL_KEY('c'):
+            editorCopy();
+            break;
+
+        case CTRL_KEY('x'):
+            editorCut();
+            break;
+
+        case CTRL_KEY('v'):
+            editorPaste();
+            break;
+
+        case CTRL_KEY('t'):
+            if (E.follow) {
+                editorFollowStop();
+                editorSetStatusMessage("Stopped following");
+            } else {
+                editorFollowStart();
+            }
+            break;
+
+        case BACKSPACE:
+        case CTRL_KEY('h'):
+        case DEL_KEY:
+            if (c == DEL_KEY)
+                editorMoveCursor(ARROW_RIGHT);
+            editorDelChar();
+            break;
+        //moves the cursor to the top of the page and then a whole screen up
+        case PAGE_UP:
+        //moves the cursor to the bottom of the page and then a whole screen down
+        case PAGE_DOWN:
+            {
+                int pages = editorKeyRepeats(c);
+                if (c == PAGE_UP) {
+                    E.cy = E.rowoff;
+                    editorMoveRows(-E.screenrows * pages);
+                } else {
+                    E.cy = E.rowoff + E.screenrows - 1;
+                    if (E.cy > E.numrows)
+                        E.cy = E.numrows;
+                    editorMoveRows(E.screenrows * pages);
+                }
+            }
+            break;
+
+        case ARROW_UP:
+        case ARROW_DOWN:
+            {
+                int times = editorKeyRepeats(c);
+                editorMoveRows(c == ARROW_UP ? -times : times);
+            }
+            break;
+
+        case ARROW_LEFT:
+        case ARROW_RIGHT:
+            {
+                int times = editorKeyRepeats(c);
+                while (times--)
+                    editorMoveCursor(c);
+            }
+            break;
+
+        case CTRL_ARROW_LEFT:
+        case CTRL_ARROW_RIGHT:
+            {
+                int times = editorKeyRepeats(c);
+                while (times--)
+                    editorMoveWord(c == CTRL_ARROW_LEFT ? -1 : 1);
+            }
+            break;
+
+        case CTRL_ARROW_UP:
+        case CTRL_ARROW_DOWN:
+            {
+                int times = editorKeyRepeats(c);
+                while (times--)
+                    editorMoveParagraph(c == CTRL_ARROW_UP ? -1 : 1);
+            }
+            break;
+
+        case CTRL_HOME_KEY:
+            E.cy = 0;
+            E.cx = 0;
+            break;
+
+        case CTRL_END_KEY:
+            E.cy = E.numrows > 0 ? E.numrows - 1 : 0;
+            E.cx = E.numrows > 0 ? E.row[E.cy].size : 0;
+            break;
+        
+        case CTRL_KEY('l'):
+            editorHelp();
+            break;
+
+        case '\x1b':
+            break;
+
+        /* This will allow any keypress that isn’t mapped to another editor 
+        function to be inserted directly into the text being edited*/
+        default:
+            editorInsertChar(c);
+            break;
+    }
+
+    quit_times = KILO_QUIT_TIMES;
+}
+
+//BATCH//
+/*the batch mode applies a script of commands to many files without a terminal:
+    goto N            moves the cursor to the start of line N
+    find TEXT         moves the cursor to the next TEXT, starting at the cursor
+    insert TEXT       types TEXT at the cursor ("\n" breaks the line)
+    delete [N]        deletes N lines (1 by default) starting at the cursor line
+    replace /OLD/NEW/ replaces every OLD of the file with NEW, which can be empty
+                      (any delimiter can be used)
+    save [PATH]       writes the file, or a copy of it to PATH
+    print             writes the file to stdout
+empty lines and lines starting with "#" are ignored. A find that fails stops 
+the script for that file, so a file is never saved half patched*/
+enum batchOp {
+    BATCH_GOTO,
+    BATCH_FIND,
+    BATCH_INSERT,
+    BATCH_DELETE,
+    BATCH_REPLACE,
+    BATCH_SAVE,
+    BATCH_PRINT
+};
+
+struct batchCommand {
+    int op;
+    int num; //line of goto, lines of delete
+    char *arg; //text of find and insert, old text of replace, path of save
+    char *arg2; //new text of replace
+    int line; //line of the script, for the error messages
+};
+
+//shared by all the workers, next and failed are protected by lock
+struct batchJob {
+    struct batchCommand *cmds;
+    int numcmds;
+    char **files;
+    int numfiles;
+    int next;
+    int failed;
+    pthread_mutex_t lock;
+};
+
+//turns "\n", "\t" and "\\" into the characters they stand for, in place
+void editorBatchUnescape(char *s) {
+    char *out = s;
+    while (*s) {
+        if (*s == '\\' && s[1]) {
+            s++;
+            *out++ = (*s == 'n') ? '\n' : (*s == 't') ? '\t' : *s;
+            s++;
+        } else {
+            *out++ = *s++;
+        }
+    }
+    *out = '\0';
+}
+
+//reads the script at path into *cmds, returns the number of commands or -1
+int editorBatchParse(char *path, struct batchCommand **cmds) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+
+    int numcmds = 0;
+    int lineno = 0;
+    char *line = NULL;
+    size_t linecap = 0;
+    ssize_t linelen;
+    *cmds = NULL;
+    while ((linelen = getline(&line, &linecap, fp)) != -1) {
+        lineno++;
+        while (linelen > 0 && (line[linelen - 1] == '\n' || line[linelen - 1] == '\r'))
+            line[--linelen] = '\0';
+        char *word = line;
+        while (isspace((unsigned char)*word))
+            word++;
+        if (*word == '\0' || *word == '#')
+            continue;
+
+        //the argument is everything after the first space
+        char *arg = strchr(word, ' ');
+        if (arg)
+            *arg++ = '\0';
+        else
+            arg = "";
+
+        struct batchCommand cmd = { -1, 0, NULL, NULL, lineno };
+        char *err = NULL; //why the command is bad, when it is more than an unknown word
+        if (!strcmp(word, "goto")) {
+            cmd.op = BATCH_GOTO;
+            cmd.num = atoi(arg);
+            if (cmd.num < 1)
+                cmd.op = -1;
+        } else if (!strcmp(word, "find") && *arg) {
+            cmd.op = BATCH_FIND;
+            cmd.arg = strdup(arg);
+            editorBatchUnescape(cmd.arg);
+        } else if (!strcmp(word, "insert")) {
+            cmd.op = BATCH_INSERT;
+            cmd.arg = strdup(arg);
+            editorBatchUnescape(cmd.arg);
+        } else if (!strcmp(word, "delete")) {
+            cmd.op = BATCH_DELETE;
+            cmd.num = *arg ? atoi(arg) : 1;
+        } else if (!strcmp(word, "replace") && *arg) {
+            //the first character is the delimiter, like in sed. NEW can be empty, OLD can't
+            char *old = &arg[1];
+            char *new = strchr(old, arg[0]);
+            char *end = new ? strchr(new + 1, arg[0]) : NULL;
+            if (end == NULL) {
+                err = "replace needs OLD and NEW between delimiters, like /OLD/NEW/";
+            } else if (new == old) {
+                err = "replace needs a non-empty OLD";
+            } else {
+                *new++ = '\0';
+                *end = '\0';
+                cmd.op = BATCH_REPLACE;
+                cmd.arg = strdup(old);
+                cmd.arg2 = strdup(new);
+                editorBatchUnescape(cmd.arg);
+                editorBatchUnescape(cmd.arg2);
+            }
+        } else if (!strcmp(word, "save")) {
+            cmd.op = BATCH_SAVE;
+            cmd.arg = *arg ? strdup(arg) : NULL;
+        } else if (!strcmp(word, "print")) {
+            cmd.op = BATCH_PRINT;
+        }
+
+        if (cmd.op == -1) {
+            if (err)
+                fprintf(stderr, "%s:%d: %s\n", path, lineno, err);
+            else
+                fprintf(stderr, "%s:%d: bad command \"%s\"\n", path, lineno, word);
+            free(line);
+            fclose(fp);
+            return -1;
+        }
+        *cmds = realloc(*cmds, sizeof(struct batchCommand) * (numcmds + 1));
+        (*cmds)[numcmds++] = cmd;
+    }
+    free(line);
+    fclose(fp);
+    return numcmds;
+}
+
+//moves the cursor to the next occurrence of query, starting at the cursor
+int editorBatchFind(char *query) {
+    size_t qlen = strlen(query);
+    struct findFilter filter;
+    editorFindFilterInit(&filter, query, E.base, E.pristine_rows);
+    int y;
+    for (y = E.cy; y < E.numrows; y++) {
+        int skip = editorFindSkip(&filter, y, 1);
+        if (skip) {
+            y += skip - 1;
+            continue;
+        }
+        erow *row = &E.row[y];
+        int from = (y == E.cy) ? E.cx : 0;
+        if (from > row->size)
+            continue;
+        //memmem() is strstr() for strings that are not '\0' terminated, like borrowed chars
+        char *match = memmem(&row->chars[from], row->size - from, query, qlen);
+        if (match) {
+            E.cy = y;
+            E.cx = match - row->chars;
+            editorFindFilterFree(&filter);
+            return 0;
+        }
+    }
+    editorFindFilterFree(&filter);
+    return -1;
+}
+
+//replaces every occurrence of old in the buffer, returns how many were replaced
+int editorBatchReplace(char *old, char *new) {
+    size_t oldlen = strlen(old);
+    size_t newlen = strlen(new);
+    int count = 0;
+    int y;
+    for (y = 0; y < E.numrows; y++) {
+        erow *row = &E.row[y];
+        char *match = memmem(row->chars, row->size, old, oldlen);
+        //most rows don't match, and those are left alone (and stay borrowed)
+        if (match == NULL)
+            continue;
+
+        struct abuf ab = ABUF_INIT;
+        char *p = row->chars;
+        char *end = &row->chars[row->size];
+        while (match) {
+            abAppend(&ab, p, match - p);
+            abAppend(&ab, new, newlen);
+            count++;
+            p = match + oldlen;
+            match = memmem(p, end - p, old, oldlen);
+        }
+        abAppend(&ab, p, end - p);
+        editorRowSetString(row, ab.b, ab.len);
+        abFree(&ab);
+    }
+    return count;
+}
+
+//applies the script to filename, on failure returns -1 and describes it in err
+int editorBatchRun(struct batchJob *job, char *filename, char *err, size_t errlen) {
+    if (editorOpen(filename) == -1) {
+        snprintf(err, errlen, "%s", strerror(errno));
+        return -1;
+    }
+    //there is no one to wait for, compressed files are decompressed right away
+    if (editorDecodeFinish() == -1) {
+        snprintf(err, errlen, "%s", E.statusmsg);
+        return -1;
+    }
+
+    int i;
+    for (i = 0; i < job->numcmds; i++) {
+        struct batchCommand *cmd = &job->cmds[i];
+        switch (cmd->op) {
+            case BATCH_GOTO:
+                E.cy = (cmd->num - 1 < E.numrows) ? cmd->num - 1 : E.numrows;
+                E.cx = 0;
+                break;
+
+            case BATCH_FIND:
+                if (editorBatchFind(cmd->arg) == -1) {
+                    snprintf(err, errlen, "script line %d: \"%s\" not found", cmd->line, cmd->arg);
+                    return -1;
+                }
+                break;
+
+            case BATCH_INSERT:
+                {
+                    char *c;
+                    for (c = cmd->arg; *c; c++) {
+                        if (*c == '\n')
+                            editorinsertNewline();
+                        else
+                            editorInsertChar(*c);
+                    }
+                }
+                break;
+
+            case BATCH_DELETE:
+                {
+                    int n = cmd->num;
+                    while (n-- > 0 && E.cy < E.numrows)
+                        editorDelRow(E.cy);
+                    E.cx = 0;
+                }
+                break;
+
+            case BATCH_REPLACE:
+                editorBatchReplace(cmd->arg, cmd->arg2);
+                break;
+
+            case BATCH_SAVE:
+            case BATCH_PRINT:
+                {
+                    size_t len;
+                    char *buf = editorRowsToString(&len);
+                    int rc = 0;
+                    if (cmd->op == BATCH_PRINT) {
+                        //a single fwrite(), so the output of the workers is not interleaved
+                        fwrite(buf, 1, len, stdout);
+                    } else {
+                        //saved like the file was, or as the name of the new one says
+                        rc = cmd->arg ? editorWriteFile(cmd->arg, editorCompressionOfName(cmd->arg), buf, len) :
+                            editorWriteFile(E.filename, E.compression, buf, len);
+                        if (rc == 0 && cmd->arg == NULL)
+                            E.dirty = 0;
+                    }
+                    free(buf);
+                    if (rc == -1) {
+                        snprintf(err, errlen, "script line %d: can't save: %s", cmd->line, strerror(errno));
+                        return -1;
+                    }
+                }
+                break;
+        }
+    }
+    return 0;
+}
+
+double editorElapsedMs(struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+//takes files from the job until there are none left, each worker has its own E
+void *editorBatchWorker(void *arg) {
+    struct batchJob *job = arg;
+    editorInitBuffer();
+    E.headless = 1;
+    E.buffers = NULL;
+    E.numbuffers = 1;
+    E.curbuf = 0;
+
+    while (1) {
+        pthread_mutex_lock(&job->lock);
+        int i = job->next++;
+        pthread_mutex_unlock(&job->lock);
+        if (i >= job->numfiles)
+            break;
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        char err[256];
+        int rc = editorBatchRun(job, job->files[i], err, sizeof(err));
+        //each report is a single fprintf(), it is written as soon as the file is done
+        if (rc == -1) {
+            pthread_mutex_lock(&job->lock);
+            job->failed++;
+            pthread_mutex_unlock(&job->lock);
+            fprintf(stderr, "%s: FAILED %s (%.3f ms)\n", job->files[i], err, editorElapsedMs(&start));
+        } else {
+            fprintf(stderr, "%s: ok (%.3f ms)\n", job->files[i], editorElapsedMs(&start));
+        }
+        editorCloseBuffer();
+    }
+    return NULL;
+}
+
+//kilo -b SCRIPT [-j WORKERS] FILE... (see the commands above)
+int editorBatch(int argc, char *argv[]) {
+    E.headless = 1;
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s -b script [-j workers] file...\n", argv[0]);
+        return 1;
+    }
+    int first = 3;
+    //one worker per core by default
+    long workers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc >= 5 && !strcmp(argv[3], "-j")) {
+        workers = atoi(argv[4]);
+        first = 5;
+    }
+
+    struct batchJob job;
+    job.numcmds = editorBatchParse(argv[2], &job.cmds);
+    if (job.numcmds == -1)
+        return 1;
+    job.files = &argv[first];
+    job.numfiles = argc - first;
+    job.next = 0;
+    job.failed = 0;
+    pthread_mutex_init(&job.lock, NULL);
+
+    if (workers > job.numfiles)
+        workers = job.numfiles;
+    if (workers < 1)
+        workers = 1;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_t *threads = malloc(sizeof(pthread_t) * workers);
+    int j;
+    for (j = 0; j < workers; j++) {
+        if (pthread_create(&threads[j], NULL, editorBatchWorker, &job) != 0)
+            die("pthread_create");
+    }
+    for (j = 0; j < workers; j++)
+        pthread_join(threads[j], NULL);
+    free(threads);
+
+    fflush(stdout);
+    fprintf(stderr, "%d files, %d failed, %ld workers, %.3f ms\n",
+        job.numfiles, job.failed, workers, editorElapsedMs(&start));
+    return job.failed ? 1 : 0;
+}
+
+//SELFTEST//
+/*kilo -t [SEED] [OPS] runs OPS random edits (100000 by default) on a buffer 
+and on a plain array of lines, and fails as soon as they differ. The buffer 
+starts with rows borrowed from a file, and snapshots are taken on the way, 
+so the copies made before a row changes are exercised too: a snapshot has 
+to keep the content it was taken with until it is released. Every edit also 
+has a budget of allocations and bytes copied (see selftestBudget()), an edit 
+that goes over it fails the test even if its result is right*/
+enum selftestOp {
+    ST_INSERT_CHAR,
+    ST_NEWLINE,
+    ST_DEL_CHAR,
+    ST_INSERT_ROW,
+    ST_DEL_ROW,
+    ST_APPEND,
+    ST_SET_STRING,
+    ST_INSERT_ROWS,
+    ST_DEL_ROWS,
+    ST_MOVE_ROWS,
+    ST_SNAPSHOT,
+    ST_OPS
+};
+
+const char *selftest_names[] = {
+    "insert char", "newline", "delete char", "insert row", "delete row",
+    "append string", "set string", "insert rows", "delete rows", "move rows",
+    "snapshot"
+};
+
+#define SELFTEST_MAX_ROWS 400
+#define SELFTEST_MAX_LEN 80
+#define SELFTEST_SNAPSHOTS 3
+
+//the reference the buffer is compared with
+struct selftestModel {
+    char **line;
+    int *len;
+    int numlines;
+};
+
+struct selftestSnapshot {
+    struct editorSnapshot *snap;
+    struct selftestModel model; //the lines when it was taken
+};
+
+//the edit being checked, the budget is worked out from it before it runs
+struct selftestEdit {
+    int op;
+    int at;
+    int n; //rows inserted, deleted or moved
+    int to; //where moved rows go
+    int col;
+    char *s;
+    int len;
+};
+
+void selftestInsertLine(struct selftestModel *m, int at, const char *s, int len) {
+    m->line = realloc(m->line, sizeof(char *) * (m->numlines + 1));
+    m->len = realloc(m->len, sizeof(int) * (m->numlines + 1));
+    memmove(&m->line[at + 1], &m->line[at], sizeof(char *) * (m->numlines - at));
+    memmove(&m->len[at + 1], &m->len[at], sizeof(int) * (m->numlines - at));
+    m->line[at] = malloc(len + 1);
+    memcpy(m->line[at], s, len);
+    m->line[at][len] = '\0';
+    m->len[at] = len;
+    m->numlines++;
+}
+
+void selftestDelLine(struct selftestModel *m, int at) {
+    free(m->line[at]);
+    memmove(&m->line[at], &m->line[at + 1], sizeof(char *) * (m->numlines - at - 1));
+    memmove(&m->len[at], &m->len[at + 1], sizeof(int) * (m->numlines - at - 1));
+    m->numlines--;
+}
+
+//replaces the len chars of line at from col with the ones of s
+void selftestSplice(struct selftestModel *m, int at, int col, int len, const char *s, int slen) {
+    char *old = m->line[at];
+    int oldlen = m->len[at];
+    char *line = malloc(oldlen - len + slen + 1);
+    memcpy(line, old, col);
+    memcpy(&line[col], s, slen);
+    memcpy(&line[col + slen], &old[col + len], oldlen - col - len);
+    m->len[at] = oldlen - len + slen;
+    line[m->len[at]] = '\0';
+    m->line[at] = line;
+    free(old);
+}
+
+void selftestCopy(struct selftestModel *dst, struct selftestModel *src) {
+    memset(dst, 0, sizeof(*dst));
+    int j;
+    for (j = 0; j < src->numlines; j++)
+        selftestInsertLine(dst, j, src->line[j], src->len[j]);
+}
+
+void selftestFree(struct selftestModel *m) {
+    int j;
+    for (j = 0; j < m->numlines; j++)
+        free(m->line[j]);
+    free(m->line);
+    free(m->len);
+    memset(m, 0, sizeof(*m));
 }
 
-void editorRefreshScreen() {
-    editorScroll();
+//random text, with the characters the column mode and the highlight care about
+int selftestText(char *buf, int max) {
+    static const char alphabet[] = "abcxyz 019,\t\"#/*";
+    int len = rand() % (max + 1);
+    int j;
+    for (j = 0; j < len; j++)
+        buf[j] = alphabet[rand() % (sizeof(alphabet) - 1)];
+    return len;
+}
 
-    struct abuf ab = ABUF_INIT;
-    // \x1b means 27 in hexa, whitch corresponds to Esc in the Ascii table
-    // Esc sequences are used to instruct terminal to formatting tasks
-    // [ is used as delimitator, what goes after is processed
-    // l command turns off terminal features
-    // ?25 is a doesnt document argument. so ?25l turns off the cursor
-    abAppend(&ab, "\x1b[?25l", 6); 
-    // H corresponds to cursor position
-    // H command recieves 2 arguments, the vertical and horizontal positions
-    // in a 20x10 terminal, move the cursor to center would be: \x1b[5;10H
-    // ergo, \x1b[H is \x1b[0;0H which corresponds to put the cursor in the top left corner
-    abAppend(&ab, "\x1b[H", 3);
-    //after mapping the terminal, all the lines are drawn the selected symbol 
-    editorDrawRows(&ab);
-    editorDrawStatusBar(&ab);
-    editorDrawMessageBar(&ab);
-    //moves the cursor to the origin (terminal uses 1-indexed values)
-    char buf[32];
-    snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (E.cy - E.rowoff) + 1, (E.rx - E.coloff) + 1);
-    abAppend(&ab, buf, strlen(buf));
-    //?25H turns the cursor back up
-    abAppend(&ab, "\x1b[?25h", 6);
-    //writes everything that was previously appended to the buffer
-    write(STDOUT_FILENO, ab.b, ab.len);
-    // abFree() deallocates dynamic memory used by abuf
-    abFree(&ab);
-    // the \x1b[?25l and \x1b[?25H might not be supported, then they will be ignored 
+/*what an edit may allocate and copy: the rows after the edited one can move 
+(moving erows, never their chars), and the chars of the rows it edits can be 
+copied twice (once out of the file or a snapshot, and once by the edit)*/
+void selftestBudget(struct selftestEdit *e, struct selftestModel *m, long *allocs, long *copied) {
+    int rows = m->numlines - e->at;
+    long chars = e->len;
+    *allocs = 0;
+    switch (e->op) {
+        case ST_INSERT_CHAR:
+            rows = 0; //a row is only added at the end
+            chars += (e->at < m->numlines) ? m->len[e->at] : 0;
+            *allocs = 4;
+            break;
+        case ST_NEWLINE:
+            chars += (e->at < m->numlines) ? m->len[e->at] : 0;
+            *allocs = 3;
+            break;
+        case ST_DEL_CHAR:
+            chars += (e->at < m->numlines) ? m->len[e->at] : 0;
+            chars += (e->at > 0) ? m->len[e->at - 1] : 0;
+            *allocs = 2;
+            break;
+        case ST_INSERT_ROW:
+            *allocs = 2;
+            break;
+        case ST_DEL_ROW:
+        case ST_DEL_ROWS:
+            break;
+        case ST_APPEND:
+            rows = 0;
+            chars += m->len[e->at];
+            *allocs = 2;
+            break;
+        case ST_SET_STRING:
+            rows = 0;
+            *allocs = 1;
+            break;
+        case ST_INSERT_ROWS:
+            *allocs = 1 + e->n;
+            break;
+        case ST_MOVE_ROWS: {
+            int j;
+            rows = m->numlines * 2; //out of their place, and into the other one
+            for (j = 0; j < e->n; j++)
+                chars += m->len[e->at + j];
+            *allocs = 1 + e->n;
+            break;
+        }
+    }
+    *copied = sizeof(erow) * (long)rows + 2 * chars + 2;
+
+    /*the row table: every chunk an edit touches can be copied first (a snapshot 
+    has it), split or merged with the next one, and the chunk pointers after it 
+    move. Moved rows are deleted and inserted, so they touch twice as many*/
+    int touched = 1;
+    if (e->op != ST_SET_STRING && e->op != ST_APPEND)
+        touched = (e->op == ST_MOVE_ROWS ? 2 : 1) * (e->n / table_chunk + 4);
+    *allocs += 3 * touched;
+    *copied += touched * ((long)sizeof(struct snapRow) * table_chunk * 2 +
+        (long)sizeof(struct tableChunk *) * (E.table.numchunks + 2));
 }
 
-/*"The three dots '...' are called an ellipsis. Using them in a function makes that 
-function a variadic function. To use them in a function declaration means that the 
-function will accept an arbitrary number of parameters after the ones already defined"*/
-void editorSetStatusMessage(const char *fmt, ...) {
-    va_list ap;
-    //initialises va_list
-    va_start(ap, fmt); //fmt is a reference to the function's last parameter
-    vsnprintf(E.statusmsg, sizeof(E.statusmsg), fmt, ap);
-    va_end(ap); //cleans up
-    E.statusmsg_time = time(NULL);
+//returns the first row where the buffer and the model differ, or -1
+int selftestCompare(struct selftestModel *m, char *why, size_t whylen) {
+    if (E.numrows != m->numlines) {
+        snprintf(why, whylen, "%d rows, expected %d", E.numrows, m->numlines);
+        return 0;
+    }
+    int j;
+    for (j = 0; j < m->numlines; j++) {
+        erow *row = &E.row[j];
+        if (row->size != m->len[j] || memcmp(row->chars, m->line[j], row->size)) {
+            snprintf(why, whylen, "row %d is \"%.*s\", expected \"%s\"", j, row->size, row->chars, m->line[j]);
+            return j;
+        }
+        if (!row->borrowed && row->chars[row->size] != '\0') {
+            snprintf(why, whylen, "row %d doesn't end with a null byte", j);
+            return j;
+        }
+    }
+    //the row table snapshots take has to follow the rows
+    struct rowTable *t = &E.table;
+    int c;
+    j = 0;
+    for (c = 0; c < t->numchunks; c++) {
+        struct tableChunk *chunk = t->chunks[c];
+        if (t->first[c] != j || chunk->count <= 0 || chunk->count > table_chunk) {
+            snprintf(why, whylen, "chunk %d of the row table starts at %d with %d rows", c, t->first[c], chunk->count);
+            return j;
+        }
+        int i;
+        for (i = 0; i < chunk->count; i++, j++) {
+            if (j >= E.numrows || chunk->rows[i].chars != E.row[j].chars || chunk->rows[i].size != E.row[j].size) {
+                snprintf(why, whylen, "row %d of the row table is not the row", j);
+                return j;
+            }
+        }
+    }
+    if (j != E.numrows) {
+        snprintf(why, whylen, "the row table has %d rows, expected %d", j, E.numrows);
+        return j;
+    }
+    return -1;
 }
 
-//INPUT//
-char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
-    size_t bufsize = 128;
-    //buf is where the string is dinamically alocated
-    char *buf = malloc(bufsize);
+//a snapshot must still have the lines it was taken with
+int selftestCheckSnapshot(struct selftestSnapshot *t, char *why, size_t whylen) {
+    struct editorSnapshot *snap = t->snap;
+    if (snap->numrows != t->model.numlines) {
+        snprintf(why, whylen, "snapshot has %d rows, expected %d", snap->numrows, t->model.numlines);
+        return -1;
+    }
+    int j;
+    int hint = 0;
+    for (j = 0; j < snap->numrows; j++) {
+        struct snapRow *row = editorSnapRow(snap, j, &hint);
+        if (row->size != t->model.len[j] || memcmp(row->chars, t->model.line[j], t->model.len[j])) {
+            snprintf(why, whylen, "snapshot row %d is \"%.*s\", expected \"%s\"", j,
+                row->size, row->chars, t->model.line[j]);
+            return -1;
+        }
+    }
+    return 0;
+}
 
-    size_t buflen = 0;
-    buf[0] = '\0';
+/*a file that shrinks after its size was taken is cut where the read ended: 
+the chunks after it read nothing, and mustn't add lines to the table*/
+int selftestShortRead(char *why, size_t whylen) {
+    char path[] = "/tmp/kilo-selftest-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1)
+        die("mkstemp");
+    unlink(path);
+    //big enough to be read in KILO_CHUNK_MIN chunks by several threads
+    size_t size = KILO_CHUNK_MIN * 4;
+    char *data = malloc(size);
+    size_t j;
+    for (j = 0; j < size; j++)
+        data[j] = (j % 61 == 60) ? '\n' : 'a' + j % 26;
+    if (write(fd, data, size) != (ssize_t)size)
+        die("write");
 
-    while (1) {
-        editorSetStatusMessage(prompt, buf);
-        editorRefreshScreen();
+    struct editorBase base;
+    memset(&base, 0, sizeof(base));
+    base.size = size;
+    //even with a single core
+    max_threads = 4;
+    //the file shrinks between the fstat() and the read, in the middle of a line
+    size_t keep = KILO_CHUNK_MIN + KILO_CHUNK_MIN / 3;
+    if (ftruncate(fd, keep) == -1)
+        die("ftruncate");
+    int rc = editorBaseLoad(&base, fd, 1);
+    max_threads = 0;
+    close(fd);
 
-        int c = editorReadKey();
-        if (c == DEL_KEY || c == CTRL_KEY('h') || c == BACKSPACE) {
-            if (buflen != 0) buf[--buflen] = '\0';
-        //if Esc (\x1b) is pressed 
-        } else if (c == '\x1b') {
-            editorSetStatusMessage("");
-            //frees the buf's memory
-            free(buf); 
-            /*the three if (callbackbuf, c) allow the caller to pass NULL 
-            for the callback if it is not needed*/
-            if (callback)
-                callback(buf, c);
-            return NULL;
-        } else if (c == '\r') {
-            if (buflen !=0) {
-                editorSetStatusMessage("");
-                if (callback)
-                    callback(buf, c);
-                return buf;
-            }
-        } else if (!iscntrl(c) && c < 128) {
-            //if buflen reached maximum capacity
-            if (buflen == bufsize - 1) {
-                //double the capacity
-                bufsize *= 2;
-                //reallocate the buffer to bufsize
-                buf = realloc(buf, bufsize);
-            }
-            buf[buflen++] = c;
-            /*buf always ends with '\0', because 
-            editorSetStatusMessage() and editorPrompt() will use it to know where the string ends */
-            buf[buflen] = '\0';
+    int numlines = 0;
+    size_t start = 0;
+    int failed = 0;
+    if (rc != -1 || base.len != keep) {
+        snprintf(why, whylen, "short read: %zu bytes loaded, expected %zu", base.len, keep);
+        failed = 1;
+    }
+    for (j = 0; j <= keep && !failed; j++) {
+        if (j < keep && data[j] != '\n')
+            continue;
+        if (j == keep && start == keep)
+            break;
+        if (numlines >= base.numlines || base.lineoff[numlines] != start ||
+            base.linelen[numlines] != (int)(j - start)) {
+            snprintf(why, whylen, "short read: line %d is wrong", numlines);
+            failed = 1;
         }
-
-        if (callback)
-            callback(buf, c);
+        numlines++;
+        start = j + 1;
     }
+    if (!failed && numlines != base.numlines) {
+        snprintf(why, whylen, "short read: %d lines, expected %d", base.numlines, numlines);
+        failed = 1;
+    }
+    free(base.data);
+    free(base.lineoff);
+    free(base.linelen);
+    free(data);
+    return failed ? -1 : 0;
 }
 
-void editorMoveCursor(int key) {
-    // if (E.cy >= E.numrows) -> NULL, else: &E.row[E.cy]
-    erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+//picks a random edit that is valid for the model
+void selftestPick(struct selftestEdit *e, struct selftestModel *m, char *buf) {
+    memset(e, 0, sizeof(*e));
+    e->s = buf;
+    //the buffer is kept between empty and SELFTEST_MAX_ROWS rows
+    do {
+        e->op = rand() % ST_OPS;
+        if (m->numlines >= SELFTEST_MAX_ROWS && (e->op == ST_INSERT_ROW || e->op == ST_INSERT_ROWS || e->op == ST_NEWLINE))
+            e->op = ST_DEL_ROWS;
+    } while (m->numlines == 0 && (e->op == ST_DEL_ROW || e->op == ST_APPEND ||
+        e->op == ST_SET_STRING || e->op == ST_DEL_ROWS || e->op == ST_MOVE_ROWS));
 
-    switch (key) {
-        case ARROW_LEFT:
-            if (E.cx != 0) {
-                E.cx--;
-            } else if (E.cy > 0) { // if you go left past the line
-                E.cy--;  // go one row up
-                E.cx = E.row[E.cy].size; // go to the last column
-            }
+    int n = m->numlines;
+    switch (e->op) {
+        case ST_INSERT_CHAR:
+        case ST_NEWLINE:
+        case ST_DEL_CHAR:
+            e->at = rand() % (n + 1);
+            e->col = (e->at < n) ? rand() % (m->len[e->at] + 1) : 0;
+            while (e->op == ST_INSERT_CHAR && e->len == 0)
+                e->len = selftestText(buf, 1);
             break;
-        case ARROW_RIGHT:
-            if (row && E.cx < row -> size) {
-                E.cx++;
-            } else if (row && E.cx == row -> size) { // if the cursor is at the end of the cursor
-                E.cy++; //move to the next line
-                E.cx = 0; //at the start of the line
-            }
+        case ST_INSERT_ROW:
+            e->at = rand() % (n + 1);
+            e->len = selftestText(buf, SELFTEST_MAX_LEN);
             break;
-        case ARROW_UP:
-            if (E.cy != 0) {
-                E.cy--;
-            }
+        case ST_DEL_ROW:
+        case ST_APPEND:
+        case ST_SET_STRING:
+            e->at = rand() % n;
+            if (e->op != ST_DEL_ROW)
+                e->len = selftestText(buf, SELFTEST_MAX_LEN);
             break;
-        case ARROW_DOWN:
-            if (E.cy < E.numrows) {
-                E.cy++;
+        case ST_INSERT_ROWS: {
+            e->at = rand() % (n + 1);
+            e->n = 1 + rand() % 8;
+            //the rows are separated by newlines in buf
+            int j;
+            for (j = 0; j < e->n; j++) {
+                e->len += selftestText(&buf[e->len], SELFTEST_MAX_LEN);
+                buf[e->len++] = '\n';
             }
             break;
+        }
+        case ST_DEL_ROWS:
+        case ST_MOVE_ROWS:
+            e->at = rand() % n;
+            e->n = 1 + rand() % (n - e->at < 16 ? n - e->at : 16);
+            e->to = rand() % (n - e->n + 1);
+            break;
     }
+}
 
-    row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
-    int rowlen = row ? row -> size : 0;
-    if (E.cx > rowlen) {
-        E.cx = rowlen;
+//runs the edit on the buffer
+void selftestApply(struct selftestEdit *e) {
+    switch (e->op) {
+        case ST_INSERT_CHAR:
+        case ST_NEWLINE:
+        case ST_DEL_CHAR:
+            E.cy = e->at;
+            E.cx = e->col;
+            if (e->op == ST_INSERT_CHAR)
+                editorInsertChar(e->s[0]);
+            else if (e->op == ST_NEWLINE)
+                editorinsertNewline();
+            else
+                editorDelChar();
+            break;
+        case ST_INSERT_ROW:
+            editorInsertRow(e->at, e->s, e->len);
+            break;
+        case ST_DEL_ROW:
+            editorDelRow(e->at);
+            break;
+        case ST_APPEND:
+            editorRowAppendString(&E.row[e->at], e->s, e->len);
+            break;
+        case ST_SET_STRING:
+            editorRowSetString(&E.row[e->at], e->s, e->len);
+            break;
+        case ST_INSERT_ROWS: {
+            erow src[8];
+            char *p = e->s;
+            int j;
+            for (j = 0; j < e->n; j++) {
+                char *nl = memchr(p, '\n', e->s + e->len - p);
+                memset(&src[j], 0, sizeof(erow));
+                src[j].chars = p;
+                src[j].size = nl - p;
+                p = nl + 1;
+            }
+            editorInsertRows(e->at, src, e->n, E.base);
+            break;
+        }
+        case ST_DEL_ROWS:
+            editorDelRows(e->at, e->n, NULL);
+            break;
+        case ST_MOVE_ROWS: {
+            //like a cut and a paste: the rows keep their chars
+            erow out[16];
+            editorDelRows(e->at, e->n, out);
+            editorInsertRows(e->to, out, e->n, E.base);
+            int j;
+            for (j = 0; j < e->n; j++)
+                editorRetireChars(&out[j]);
+            break;
+        }
     }
 }
 
-//waits for a keypress and handles it
-void editorProcessKeypress() {
-    static int quit_times = KILO_QUIT_TIMES;
-
-    int c = editorReadKey();
-    //this switch has the keypress cases in it
-    switch (c) {
-        case '\r':
-            editorinsertNewline();
+//runs the edit on the model
+void selftestModelApply(struct selftestEdit *e, struct selftestModel *m) {
+    switch (e->op) {
+        case ST_INSERT_CHAR:
+            if (e->at == m->numlines)
+                selftestInsertLine(m, e->at, "", 0);
+            selftestSplice(m, e->at, e->col, 0, e->s, 1);
             break;
-
-        case CTRL_KEY('q'):
-            if (E.dirty && quit_times > 0) {
-                editorSetStatusMessage("WARNING!!! File has unsaved changes. Press Ctrl-Q %d more times to quit.", quit_times);
-                quit_times--;
-                return;
+        case ST_NEWLINE:
+            if (e->at == m->numlines || e->col == 0) {
+                selftestInsertLine(m, e->at, "", 0);
+            } else {
+                selftestInsertLine(m, e->at + 1, &m->line[e->at][e->col], m->len[e->at] - e->col);
+                selftestSplice(m, e->at, e->col, m->len[e->at] - e->col, "", 0);
             }
-            write(STDOUT_FILENO, "\x1b[2J", 4);
-            write(STDOUT_FILENO, "\x1b[H", 3);    
-            exit(0);
             break;
-
-        case CTRL_KEY('s'):
-            editorSave();
+        case ST_DEL_CHAR:
+            if (e->at == m->numlines || (e->at == 0 && e->col == 0))
+                break;
+            if (e->col > 0) {
+                selftestSplice(m, e->at, e->col - 1, 1, "", 0);
+            } else {
+                selftestSplice(m, e->at - 1, m->len[e->at - 1], 0, m->line[e->at], m->len[e->at]);
+                selftestDelLine(m, e->at);
+            }
             break;
-
-        case HOME_KEY:
-            E.cx = 0;
+        case ST_INSERT_ROW:
+            selftestInsertLine(m, e->at, e->s, e->len);
             break;
-
-        // If there is no current line, then E.cx must be 0 and it should stay at 0, so there’s nothing to do
-        case END_KEY:
-            if (E.cy < E.numrows)
-                E.cx = E.row[E.cy].size;
+        case ST_DEL_ROW:
+            selftestDelLine(m, e->at);
             break;
-        
-        case CTRL_KEY('f'):
-            editorFind();
+        case ST_APPEND:
+            selftestSplice(m, e->at, m->len[e->at], 0, e->s, e->len);
             break;
-
-        case BACKSPACE:
-        case CTRL_KEY('h'):
-        case DEL_KEY:
-            if (c == DEL_KEY)
-                editorMoveCursor(ARROW_RIGHT);
-            editorDelChar();
+        case ST_SET_STRING:
+            selftestSplice(m, e->at, 0, m->len[e->at], e->s, e->len);
             break;
-        //movescursor to the top of the page and simulates 
-        //the command ARROW_UP the equivalent of times to move the entire screen 
-        case PAGE_UP:
-        //movescursor to the bottom of the page and simulates 
-        //the command ARROW_DOWN the equivalent of times to move the entire screen 
-        case PAGE_DOWN:
-            {
-                if (c == PAGE_UP) {
-                    E.cy = E.rowoff;
-                } else  if (c == PAGE_DOWN) {
-                    E.cy = E.rowoff + E.screenrows -1;
-                    if (E.cy > E.numrows) 
-                        E.cy = E.numrows;
-                }
-                int times = E.screenrows;
-                while (times--)
-                    // if c == PAGE_UP, do ARROW_UP, else, ARROW_DOWN
-                    editorMoveCursor(c == PAGE_UP ? ARROW_UP : ARROW_DOWN);
+        case ST_INSERT_ROWS: {
+            char *p = e->s;
+            int j;
+            for (j = 0; j < e->n; j++) {
+                char *nl = memchr(p, '\n', e->s + e->len - p);
+                selftestInsertLine(m, e->at + j, p, nl - p);
+                p = nl + 1;
             }
             break;
-
-        case ARROW_UP:
-        case ARROW_DOWN:
-        case ARROW_LEFT:
-        case ARROW_RIGHT:
-            editorMoveCursor(c);
+        }
+        case ST_DEL_ROWS: {
+            int j;
+            for (j = 0; j < e->n; j++)
+                selftestDelLine(m, e->at);
             break;
-        
-        case CTRL_KEY('l'):
-        case '\x1b':
+        }
+        case ST_MOVE_ROWS: {
+            struct selftestModel moved = {0};
+            int j;
+            for (j = 0; j < e->n; j++) {
+                selftestInsertLine(&moved, j, m->line[e->at], m->len[e->at]);
+                selftestDelLine(m, e->at);
+            }
+            for (j = 0; j < e->n; j++)
+                selftestInsertLine(m, e->to + j, moved.line[j], moved.len[j]);
+            selftestFree(&moved);
             break;
+        }
+    }
+}
 
-        /* This will allow any keypress that isn’t mapped to another editor 
-        function to be inserted directly into the text being edited*/
-        default:
-            editorInsertChar(c);
-            break;
+//kilo -t [SEED] [OPS] (see above), returns 1 at the first failure
+int editorSelftest(int argc, char *argv[]) {
+    E.headless = 1;
+    editorInitBuffer();
+    unsigned int seed = (argc >= 3) ? (unsigned int)strtoul(argv[2], NULL, 10) : (unsigned int)(time(NULL) ^ getpid());
+    long ops = (argc >= 4) ? atol(argv[3]) : 100000;
+    srand(seed);
+
+    //tiny chunks, so the row table is split and merged all the time
+    table_chunk = 8;
+    //the first rows are borrowed from a file, like after editorOpen()
+    struct selftestModel model = {0};
+    char path[] = "/tmp/kilo-selftest-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1)
+        die("mkstemp");
+    char buf[(SELFTEST_MAX_LEN + 1) * 8];
+    int j;
+    for (j = 0; j < 50; j++) {
+        int len = selftestText(buf, SELFTEST_MAX_LEN);
+        selftestInsertLine(&model, j, buf, len);
+        buf[len] = '\n';
+        if (write(fd, buf, len + 1) != len + 1)
+            die("write");
     }
+    close(fd);
+    int rc = editorOpen(path);
+    unlink(path);
+    if (rc == -1)
+        die("open");
 
-    quit_times = KILO_QUIT_TIMES;
+    struct selftestSnapshot snaps[SELFTEST_SNAPSHOTS];
+    int numsnaps = 0;
+    long counts[ST_OPS] = {0};
+    char why[256];
+    int failed = 0;
+    if (selftestShortRead(why, sizeof(why)) == -1) {
+        fprintf(stderr, "%s\n", why);
+        failed = 1;
+    }
+    long i;
+    for (i = 0; i < ops && !failed; i++) {
+        struct selftestEdit e;
+        selftestPick(&e, &model, buf);
+        counts[e.op]++;
+
+        if (e.op == ST_SNAPSHOT) {
+            //takes one while there is room, otherwise checks and releases one
+            if (numsnaps < SELFTEST_SNAPSHOTS && rand() % 2) {
+                //it copies the chunk pointers of the row table, nothing else
+                struct rowStats before = rowstats;
+                snaps[numsnaps].snap = editorSnapshotTake();
+                long copied = rowstats.copied - before.copied;
+                long max_copied = (long)(sizeof(struct tableChunk *) + sizeof(int)) * E.table.numchunks;
+                if (rowstats.allocs - before.allocs > 2 || copied > max_copied) {
+                    fprintf(stderr, "edit %ld (snapshot): %ld bytes copied, the budget is %ld\n", i, copied, max_copied);
+                    failed = 1;
+                }
+                selftestCopy(&snaps[numsnaps].model, &model);
+                numsnaps++;
+            } else if (numsnaps > 0) {
+                int k = rand() % numsnaps;
+                if (selftestCheckSnapshot(&snaps[k], why, sizeof(why)) == -1) {
+                    fprintf(stderr, "edit %ld (snapshot): %s\n", i, why);
+                    failed = 1;
+                }
+                editorSnapshotRelease(snaps[k].snap);
+                selftestFree(&snaps[k].model);
+                snaps[k] = snaps[--numsnaps];
+            }
+            continue;
+        }
+
+        long max_allocs, max_copied;
+        selftestBudget(&e, &model, &max_allocs, &max_copied);
+        struct rowStats before = rowstats;
+        selftestApply(&e);
+        long allocs = rowstats.allocs - before.allocs;
+        long copied = rowstats.copied - before.copied;
+        selftestModelApply(&e, &model);
+
+        if (allocs > max_allocs) {
+            snprintf(why, sizeof(why), "%ld allocations, the budget is %ld", allocs, max_allocs);
+            failed = 1;
+        } else if (copied > max_copied) {
+            snprintf(why, sizeof(why), "%ld bytes copied, the budget is %ld", copied, max_copied);
+            failed = 1;
+        } else if (selftestCompare(&model, why, sizeof(why)) != -1) {
+            failed = 1;
+        }
+        if (failed)
+            fprintf(stderr, "edit %ld (%s at row %d, col %d, %d rows): %s\n", i, selftest_names[e.op], e.at, e.col, e.n, why);
+    }
+
+    //the snapshots still held are checked too
+    for (j = 0; j < numsnaps; j++) {
+        if (!failed && selftestCheckSnapshot(&snaps[j], why, sizeof(why)) == -1) {
+            fprintf(stderr, "after the last edit: %s\n", why);
+            failed = 1;
+        }
+        editorSnapshotRelease(snaps[j].snap);
+        selftestFree(&snaps[j].model);
+    }
+    selftestFree(&model);
+
+    for (j = 0; j < ST_OPS; j++)
+        fprintf(stderr, "%-14s %ld\n", selftest_names[j], counts[j]);
+    fprintf(stderr, "%ld edits, %ld allocations, %ld bytes copied: %s (kilo -t %u %ld)\n",
+        i, rowstats.allocs, rowstats.copied, failed ? "FAILED" : "ok", seed, ops);
+    return failed;
 }
 
 //INIT//
 void initEditor() {
-    //setting x and y coordinates of the cursor relative to the text file
-    E.cx = 0; //horizontal index into the chars field of an erow
-    E.cy = 0; //vertical
-    E.rx = 0; //horizontal index into the render field of an erow
-    E.rowoff = 0; //starts at the top row
-    E.coloff = 0; //starts at the leftmost column
-    E.numrows = 0; //couonter starts at zero
-    E.row = NULL; //row depends of the generation of erow structs being attached to it
-    E.dirty = 0; //tracksif the text loaded differs from whats in the file (can warn for unsaved changes)
-    E.filename = NULL; //as long as the file is not opened, the value of E.filename is NULL
+    editorInitBuffer();
+    E.buffers = malloc(sizeof(struct editorBuffer));
+    E.numbuffers = 1;
+    E.curbuf = 0;
     E.statusmsg[0] = '\0';
     E.statusmsg_time = 0;
 
@@ -965,17 +6319,39 @@ void initEditor() {
 }
 
 int main(int argc, char *argv[]) {
+    //the batch mode never touches the terminal
+    if (argc >= 2 && !strcmp(argv[1], "-b"))
+        return editorBatch(argc, argv);
+    //so does the self test of the row operations
+    if (argc >= 2 && !strcmp(argv[1], "-t"))
+        return editorSelftest(argc, argv);
+
     enableRawMode();
     initEditor();
-    if (argc >= 2) {
-        editorOpen(argv[1]);
+    editorOutputStart();
+    //"-f" follows the files as they grow, like tail -f
+    int follow = (argc >= 2 && !strcmp(argv[1], "-f"));
+    //every file gets its own buffer, the first one is shown
+    int j;
+    for (j = 1 + follow; j < argc; j++) {
+        if (j > 1 + follow)
+            editorNewBuffer();
+        if (editorOpen(argv[j]) == -1)
+            die("fopen");
+        if (follow)
+            editorFollowStart();
     }
+    editorSwitchBuffer(0);
 
-    //argument is the inicial message (can be got passing NULL to time())
-    editorSetStatusMessage("HELP: Ctrl-s = save | Ctrl-Q = quit | Ctrl-f = find");
+    //the first page of the help is the inicial message
+    editorHelp();
 
     while (1) {
-        editorRefreshScreen();
+        //while keys are still waiting, frames are only drawn KILO_FPS times per second
+        if (!editorKeyPending() || editorFrameDue())
+            editorRefreshScreen();
+        else
+            editorScroll();
         editorProcessKeypress();
     }
 